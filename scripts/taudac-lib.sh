@@ -0,0 +1,114 @@
+# SPDX-License-Identifier: GPL-2.0
+#
+# Helpers shared by the TauDAC test scripts, to be sourced
+#
+# They run against the real card and need root for debugfs and tracefs,
+# and alsa-utils. CARD is the ALSA card id, which is also the card's
+# debugfs directory name unless taudac,model says otherwise.
+
+CARD=${CARD:-TauDAC}
+CARD_DEBUGFS=${CARD_DEBUGFS:-$CARD}
+DEBUGFS=${DEBUGFS:-/sys/kernel/debug}
+TRACEFS=${TRACEFS:-/sys/kernel/tracing}
+
+die() {
+	echo "$(basename "$0"): $*" >&2
+	exit 2
+}
+
+taudac_check() {
+	[ -e "/proc/asound/$CARD" ] || die "no ALSA card $CARD"
+	[ -d "$DEBUGFS/asoc/$CARD_DEBUGFS" ] ||
+		die "no $DEBUGFS/asoc/$CARD_DEBUGFS, is debugfs mounted?"
+	command -v aplay > /dev/null || die "aplay not found"
+}
+
+# i2c_stats of the Si5351 and of the codecs of the card
+taudac_i2c_files() {
+	find "$DEBUGFS"/si5351-* "$DEBUGFS/asoc/$CARD_DEBUGFS" \
+		-name i2c_stats 2> /dev/null
+}
+
+taudac_i2c_snapshot() {
+	local f
+
+	for f in $(taudac_i2c_files); do
+		echo 1 > "$(dirname "$f")/i2c_snapshot"
+	done
+}
+
+# "reads writes bytes bus_us" since the snapshot, over all devices
+taudac_i2c_delta() {
+	local f
+
+	for f in $(taudac_i2c_files); do
+		cat "$f"
+	done | awk '
+		$1 != "range" {
+			gsub(/[()]/, "")
+			r += $7; w += $8; b += $9; us += $11
+		}
+		END { printf "%d %d %d %d\n", r, w, b, us }'
+}
+
+# taudac_play <rate> <width> [seconds]: plays silence
+taudac_play() {
+	local fmt
+
+	case $2 in
+	16) fmt=S16_LE ;;
+	24) fmt=S24_LE ;;
+	32) fmt=S32_LE ;;
+	*) die "unsupported width $2" ;;
+	esac
+
+	aplay -q -D "hw:$CARD" -t raw -f "$fmt" -r "$1" -c 2 \
+		-d "${3:-1}" /dev/zero
+}
+
+# waits for the card to release its clocks on autosuspend
+taudac_wait_suspended() {
+	local f n
+
+	f=/sys/class/sound/$(readlink "/proc/asound/$CARD")
+	f=$f/device/power/runtime_status
+	for n in $(seq 60); do
+		[ "$(cat "$f")" = suspended ] && return 0
+		sleep 1
+	done
+
+	die "card did not autosuspend"
+}
+
+# taudac_trace_start [event]: records the taudac events, or just one
+taudac_trace_start() {
+	echo 0 > "$TRACEFS/tracing_on"
+	echo 0 > "$TRACEFS/events/taudac/enable"
+	echo > "$TRACEFS/trace"
+	echo 1 > "$TRACEFS/events/taudac/${1:+$1/}enable"
+	echo 1 > "$TRACEFS/tracing_on"
+}
+
+taudac_trace_stop() {
+	echo 0 > "$TRACEFS/events/taudac/enable"
+}
+
+# "event count total_us" for each event that reports a duration
+taudac_trace_durations() {
+	awk '
+		{
+			for (i = 1; i <= NF; i++) {
+				if ($i ~ /^(taudac|si5351|wm8741)_.*:$/)
+					ev = substr($i, 1, length($i) - 1)
+				if ($i ~ /^(duration|settle)_ns=/) {
+					split($i, v, "=")
+					sum[ev] += v[2]
+					n[ev]++
+				}
+			}
+		}
+		END {
+			for (ev in sum)
+				printf "%s %d %d\n", ev, n[ev], sum[ev] / 1000
+		}' "$TRACEFS/trace"
+}
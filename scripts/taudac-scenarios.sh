@@ -0,0 +1,67 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Runs the stream lifecycle scenarios on the card and reports the I2C
+# traffic and the traced setup time of each:
+#
+#   scenario  reads writes bytes bus_us  hw_params_us total_traced_us
+#
+# Usage: sudo CARD=TauDAC scripts/taudac-scenarios.sh
+
+. "$(dirname "$0")/taudac-lib.sh"
+
+# the wait is not part of the first open
+taudac_wait_suspended_play() {
+	taudac_wait_suspended
+	taudac_i2c_snapshot
+	taudac_trace_start
+	taudac_play "$@"
+}
+
+taudac_scenario() {
+	local name=$1 cmd=$2 i2c trace hw total
+
+	taudac_i2c_snapshot
+	taudac_trace_start
+	eval "$cmd" || die "$name: '$cmd' failed"
+	taudac_trace_stop
+
+	i2c=$(taudac_i2c_delta)
+	trace=$(taudac_trace_durations)
+	hw=$(echo "$trace" | awk '$1 == "taudac_hw_params" { print $3 }')
+	total=$(echo "$trace" | awk '{ us += $3 } END { print us + 0 }')
+
+	printf "%-18s %s %d %d\n" "$name" "$i2c" "${hw:-0}" "$total"
+}
+
+taudac_check
+
+VOLUME_CTL=${VOLUME_CTL:-Left Playback Volume}
+
+ctl_get() {
+	amixer -c "$CARD" cget name="$1" | awk -F= '/: values/ { print $2 }'
+}
+
+# the controls are changed to a value they do not have yet
+filter=$(ctl_get Filter)
+volume=$(ctl_get "$VOLUME_CTL")
+
+# scenario name and command, in order; each one starts from the state
+# the previous one left behind
+SCENARIOS=(
+	"first_open_44k1	taudac_wait_suspended_play 44100 16"
+	"reopen_44k1	taudac_play 44100 16"
+	"family_48k	taudac_play 48000 16"
+	"width_24	taudac_play 48000 24"
+	"volume	amixer -q -c $CARD cset name='$VOLUME_CTL' $((volume == 900 ? 800 : 900))"
+	"filter	amixer -q -c $CARD cset name=Filter $((filter == 1 ? 0 : 1))"
+	"autosuspend	taudac_wait_suspended"
+)
+
+echo "# scenario reads writes bytes bus_us hw_params_us total_traced_us"
+for s in "${SCENARIOS[@]}"; do
+	taudac_scenario "${s%%	*}" "${s#*	}"
+done
+
+amixer -q -c "$CARD" cset name=Filter "$filter"
+amixer -q -c "$CARD" cset name="$VOLUME_CTL" "$volume"
@@ -0,0 +1,114 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Opens, plays and closes the card many times over random rates and
+# widths. Fails on a clock enable/disable imbalance, on clock enable or
+# playback failures, and when hw_params gets slower over the run.
+#
+# Usage: sudo CARD=TauDAC ITERATIONS=1000 scripts/taudac-soak.sh
+#
+# ITERATIONS	stream opens (1000)
+# PLAY_SECONDS	length of each stream (1)
+# DRIFT		allowed ratio of the mean hw_params time of the last tenth
+#		of the run to that of the first tenth (2)
+# SEED		seed of the rate/width sequence
+
+. "$(dirname "$0")/taudac-lib.sh"
+
+ITERATIONS=${ITERATIONS:-1000}
+PLAY_SECONDS=${PLAY_SECONDS:-1}
+DRIFT=${DRIFT:-2}
+RANDOM=${SEED:-$$}
+
+RATES=(32000 44100 48000 88200 96000 176400 192000)
+WIDTHS=(16 24 32)
+
+STATS=$DEBUGFS/asoc/$CARD_DEBUGFS/stats
+
+# checks "<clock>: <n> enables, <m> disables, on|off" of the stats
+check_balance() {
+	awk -v clk="$1:" '
+		$1 == clk {
+			d = $2 - $4
+			if (d != ($6 == "on")) {
+				printf "%s %d enables, %d disables while %s\n",
+				       clk, $2, $4, $6
+				exit 1
+			}
+			printf "%s balanced (%d enables)\n", clk, $2
+		}' "$STATS"
+}
+
+taudac_check
+fail=0
+
+echo 1 > "$DEBUGFS/asoc/$CARD_DEBUGFS/stats_reset"
+taudac_trace_start taudac_hw_params
+
+errors=0
+for n in $(seq "$ITERATIONS"); do
+	rate=${RATES[RANDOM % ${#RATES[@]}]}
+	width=${WIDTHS[RANDOM % ${#WIDTHS[@]}]}
+	if ! taudac_play "$rate" "$width" "$PLAY_SECONDS"; then
+		echo "iteration $n: playback at $rate/$width failed"
+		errors=$((errors + 1))
+	fi
+done
+
+taudac_trace_stop
+[ $errors -eq 0 ] || fail=1
+
+durations=$(mktemp)
+trap 'rm -f "$durations"' EXIT
+
+# hw_params times in the order of the run
+awk '
+	/ taudac_hw_params: / {
+		for (i = 1; i <= NF; i++)
+			if ($i ~ /^duration_ns=/) {
+				split($i, v, "=")
+				print v[2] / 1000
+			}
+	}' "$TRACEFS/trace" > "$durations"
+
+awk -v drift="$DRIFT" '
+	{ t[NR] = $1 }
+	END {
+		if (NR < 10) {
+			print "too few hw_params events traced"
+			exit 1
+		}
+		tenth = int(NR / 10)
+		for (i = 1; i <= tenth; i++) {
+			first += t[i]
+			last += t[NR - tenth + i]
+		}
+		first /= tenth
+		last /= tenth
+		printf "hw_params: %d calls, first tenth %.0f us, last tenth %.0f us\n",
+		       NR, first, last
+		exit last > first * drift
+	}' "$durations" || fail=1
+
+sort -n "$durations" | awk '
+	{ t[NR] = $1 }
+	END {
+		if (!NR)
+			exit
+		printf "hw_params us: p50 %.0f  p90 %.0f  p99 %.0f  max %.0f\n",
+		       t[int(NR * 0.5) + 1], t[int(NR * 0.9) + 1],
+		       t[int(NR * 0.99) + 1], t[NR]
+	}'
+
+check_balance mclk || fail=1
+check_balance i2s_clks || fail=1
+awk '$1 == "clk_enable_failures:" && $2 != 0 { print; exit 1 }' "$STATS" ||
+	fail=1
+
+# once the clocks are released, the counts have to be equal
+taudac_wait_suspended
+check_balance mclk || fail=1
+check_balance i2s_clks || fail=1
+
+echo "$ITERATIONS streams, $errors playback errors: $([ $fail -eq 0 ] && echo PASS || echo FAIL)"
+exit $fail
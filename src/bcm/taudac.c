@@ -16,16 +16,40 @@
 
 #include <linux/module.h>
 #include <linux/platform_device.h>
+#include <linux/pm_runtime.h>
 
 #include <sound/core.h>
 #include <sound/soc.h>
 #include <sound/pcm_params.h>
 #include "../codecs/wm8741.h"
+#include "../clk/clk-si5351.h"
+#include "taudac_stream.h"
 
 #include <linux/delay.h>
 #include <linux/of_gpio.h>
+#include <linux/gpio/consumer.h>
 #include <linux/i2c.h>
 #include <linux/clk.h>
+#include <linux/debugfs.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
+#include <linux/notifier.h>
+#include <linux/spinlock.h>
+#include <linux/timekeeping.h>
+#include <linux/workqueue.h>
+
+#define CREATE_TRACE_POINTS
+#define TAUDAC_TRACE_CARD
+#include "taudac_trace.h"
+
+/* the clocks are kept running this long after the last stream closed */
+#define TAUDAC_AUTOSUSPEND_DELAY_MS	10000
+
+/* clock servo update interval and PI gains (as right shifts) */
+#define TAUDAC_SERVO_PERIOD_MS		1000
+#define TAUDAC_SERVO_KP_SHIFT		3
+#define TAUDAC_SERVO_KI_SHIFT		6
 
 /*
  * clocks
@@ -44,18 +68,85 @@ enum {
 	NUM_LRCLKS
 };
 
+/* left and right WM8741 */
+#define TAUDAC_NUM_CODECS	2
+
+/*
+ * statistics, bucket n of a histogram counts durations of [2^(n-1), 2^n)
+ * microseconds, bucket 0 those below one microsecond
+ */
+#define TAUDAC_HIST_BUCKETS	24
+
+struct taudac_hist {
+	u32 bucket[TAUDAC_HIST_BUCKETS];
+};
+
+struct taudac_stats {
+	struct taudac_hist hw_params;
+	struct taudac_hist shutdown;
+	struct taudac_hist mclk_settle;
+	struct taudac_hist i2s_clks_enable;
+	u32 family_switches;
+	u32 hw_params_repeats;
+	u32 clk_enable_failures;
+	/* enables - disables has to match the clock state, else it leaks */
+	u32 mclk_enables;
+	u32 mclk_disables;
+	u32 i2s_clks_enables;
+	u32 i2s_clks_disables;
+};
+
 struct snd_soc_card_drvdata {
 	struct clk *mclk24;
 	struct clk *mclk22;
 	struct clk *mclk_mux;
 	struct clk *mclk_gate;
+	struct clk *mclk_ext;
+	struct clk *mclk_src;
+	bool use_mclk_ext;
+	bool trim_supported;
 	struct clk *bclk[NUM_BCLKS];
 	struct clk *lrclk[NUM_LRCLKS];
+	struct gpio_desc *mute_gpio;
+	struct work_struct mute_work;
+	bool mute_state;
+	unsigned long mclk_rate;
+	unsigned long bclk_rate;
+	unsigned long lrclk_rate;
 	bool mclk_enabled;
+	bool i2s_clks_enabled;
+	bool clks_suspended;
 	bool bclk_prepared[NUM_BCLKS];
 	bool lrclk_prepared[NUM_BCLKS];
+	unsigned int filter_policy;
+	unsigned int user_filter;
+	bool filter_override;
+	struct snd_soc_card *card;
+	struct notifier_block clk_nb;
+	bool clk_nb_registered;
+	struct snd_kcontrol *clk_fault_kctl;
+	unsigned int clk_fault;
+	spinlock_t substream_lock;
+	struct snd_pcm_substream *substream;
+	struct delayed_work servo_work;
+	bool servo_enabled;
+	bool servo_running;
+	bool servo_locked;
+	u64 servo_frames;
+	snd_pcm_uframes_t servo_hw_ptr;
+	u64 servo_t0;
+	s64 servo_integral;
+	struct taudac_stats stats;
 };
 
+static void taudac_hist_add(struct taudac_hist *hist, u64 ns)
+{
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	unsigned int n = us ? ilog2(us) + 1 : 0;
+
+	hist->bucket[min_t(unsigned int, n, TAUDAC_HIST_BUCKETS - 1)]++;
+}
+
 static int taudac_i2s_clks_init(struct snd_soc_card_drvdata *drvdata)
 {
 	int ret, i, k, num_clks;
@@ -103,32 +194,64 @@ static int taudac_i2s_clks_init(struct snd_soc_card_drvdata *drvdata)
 	return 0;
 }
 
+/*
+ * Si5351 register profiles, if the board provides any, are listed one
+ * per rate family in this order.
+ */
+enum {
+	TAUDAC_PROFILE_48K,
+	TAUDAC_PROFILE_44K1,
+};
+
+static int taudac_clk_profile(struct snd_soc_card_drvdata *drvdata,
+		unsigned long mclk_rate)
+{
+	unsigned int index = (mclk_rate % 11025 == 0) ?
+			TAUDAC_PROFILE_44K1 : TAUDAC_PROFILE_48K;
+
+	return si5351_clk_apply_profile(drvdata->bclk[BCLK_CPU], index);
+}
+
+static struct clk *taudac_i2s_clk(struct snd_soc_card_drvdata *drvdata,
+		int i)
+{
+	return (i < NUM_BCLKS) ? drvdata->bclk[i] :
+			drvdata->lrclk[i - NUM_BCLKS];
+}
+
 static void taudac_i2s_clks_disable(struct snd_soc_card_drvdata *drvdata)
 {
 	int i;
 
+	if (drvdata->i2s_clks_enabled) {
+		for (i = 0; i < NUM_BCLKS + NUM_LRCLKS; i++)
+			clk_disable(taudac_i2s_clk(drvdata, i));
+		drvdata->i2s_clks_enabled = false;
+		drvdata->stats.i2s_clks_disables++;
+	}
+
 	for (i = 0; i < NUM_BCLKS; i++) {
 		if (drvdata->bclk_prepared[i]) {
-			clk_disable_unprepare(drvdata->bclk[i]);
+			clk_unprepare(drvdata->bclk[i]);
 			drvdata->bclk_prepared[i] = false;
 		}
 	}
 
 	for (i = 0; i < NUM_LRCLKS; i++) {
 		if (drvdata->lrclk_prepared[i]) {
-			clk_disable_unprepare(drvdata->lrclk[i]);
+			clk_unprepare(drvdata->lrclk[i]);
 			drvdata->lrclk_prepared[i] = false;
 		}
 	}
 }
 
-static int taudac_i2s_clks_enable(struct snd_soc_card_drvdata *drvdata)
+static int _taudac_i2s_clks_enable(struct snd_soc_card_drvdata *drvdata)
 {
 	int ret, i;
 
 	for (i = 0; i < NUM_BCLKS; i++) {
 		if (!drvdata->bclk_prepared[i]) {
-			ret = clk_prepare_enable(drvdata->bclk[i]);
+			ret = clk_prepare(drvdata->bclk[i]);
 			if (ret != 0)
 				return ret;
 			drvdata->bclk_prepared[i] = true;
@@ -137,39 +260,95 @@ static int taudac_i2s_clks_enable(struct snd_soc_card_drvdata *drvdata)
 
 	for (i = 0; i < NUM_LRCLKS; i++) {
 		if (!drvdata->lrclk_prepared[i]) {
-			ret = clk_prepare_enable(drvdata->lrclk[i]);
+			ret = clk_prepare(drvdata->lrclk[i]);
 			if (ret != 0)
 				return ret;
 			drvdata->lrclk_prepared[i] = true;
 		}
 	}
 
+	if (drvdata->i2s_clks_enabled)
+		return 0;
+
+	for (i = 0; i < NUM_BCLKS + NUM_LRCLKS; i++) {
+		ret = clk_enable(taudac_i2s_clk(drvdata, i));
+		if (ret != 0) {
+			while (--i >= 0)
+				clk_disable(taudac_i2s_clk(drvdata, i));
+			return ret;
+		}
+	}
+	drvdata->i2s_clks_enabled = true;
+	drvdata->stats.i2s_clks_enables++;
+
 	return 0;
 }
 
+/*
+ * The Si5351 OEB pin is held while the clocks are prepared and enabled,
+ * so all outputs routed through it start on the edge of its release.
+ */
+static int taudac_i2s_clks_enable(struct snd_soc_card_drvdata *drvdata)
+{
+	struct clk *clk = drvdata->bclk[BCLK_CPU];
+	bool held;
+	int ret;
+
+	held = si5351_clk_oeb_hold(clk, true) == 0;
+	ret = _taudac_i2s_clks_enable(drvdata);
+	if (held)
+		si5351_clk_oeb_hold(clk, false);
+
+	return ret;
+}
+
 static void taudac_mclk_disable(struct snd_soc_card_drvdata *drvdata)
 {
 	if (drvdata->mclk_enabled) {
 		clk_disable_unprepare(drvdata->mclk_gate);
 		drvdata->mclk_enabled = false;
+		drvdata->stats.mclk_disables++;
 	}
 }
 
-static int taudac_mclk_enable(struct snd_soc_card_drvdata *drvdata,
+/*
+ * In slave mode the master clock, and with it the Si5351 PLLs, follow an
+ * external reference. Its rate has to match the rate family played.
+ */
+static struct clk *taudac_mclk_src(struct snd_soc_card_drvdata *drvdata,
 		unsigned long mclk_rate)
 {
-	int ret;
+	if (drvdata->use_mclk_ext) {
+		if (clk_get_rate(drvdata->mclk_ext) != mclk_rate)
+			return ERR_PTR(-EINVAL);
+		return drvdata->mclk_ext;
+	}
 
 	switch (mclk_rate) {
 	case 22579200:
-		ret = clk_set_parent(drvdata->mclk_mux, drvdata->mclk22);
-		break;
+		return drvdata->mclk22;
 	case 24576000:
-		ret = clk_set_parent(drvdata->mclk_mux, drvdata->mclk24);
-		break;
+		return drvdata->mclk24;
 	default:
-		return -EINVAL;
+		return ERR_PTR(-EINVAL);
 	}
+}
+
+static int taudac_mclk_enable(struct snd_soc_card_drvdata *drvdata,
+		unsigned long mclk_rate)
+{
+	struct clk *src;
+	int ret;
+
+	src = taudac_mclk_src(drvdata, mclk_rate);
+	if (IS_ERR(src))
+		return PTR_ERR(src);
+
+	/* already running at this rate, no need to wait for it to settle */
+	if (drvdata->mclk_enabled && drvdata->mclk_src == src)
+		return 0;
+
+	ret = clk_set_parent(drvdata->mclk_mux, src);
 	if (ret < 0)
 		return ret;
 
@@ -178,6 +357,9 @@ static int taudac_mclk_enable(struct snd_soc_card_drvdata *drvdata,
 		return ret;
 
 	drvdata->mclk_enabled = true;
+	drvdata->stats.mclk_enables++;
+	drvdata->mclk_src = src;
+	drvdata->mclk_rate = mclk_rate;
 	msleep(20);
 
 	return 0;
@@ -200,9 +382,81 @@ static int taudac_i2s_clks_set_rate(struct snd_soc_card_drvdata *drvdata,
 			return ret;
 	}
 
+	drvdata->bclk_rate = bclk_rate;
+	drvdata->lrclk_rate = lrclk_rate;
+
 	return 0;
 }
 
+static void taudac_clks_release(struct snd_soc_card_drvdata *drvdata)
+{
+	taudac_i2s_clks_disable(drvdata);
+	taudac_mclk_disable(drvdata);
+}
+
+/* re-establish the last clock configuration, e.g. after system sleep */
+static int taudac_clks_restore(struct snd_soc_card_drvdata *drvdata)
+{
+	int ret;
+
+	ret = taudac_mclk_enable(drvdata, drvdata->mclk_rate);
+	if (ret < 0)
+		return ret;
+
+	if (drvdata->bclk_rate == 0)
+		return 0;
+
+	ret = taudac_i2s_clks_set_rate(drvdata, drvdata->bclk_rate,
+			drvdata->lrclk_rate);
+	if (ret < 0)
+		return ret;
+
+	return taudac_i2s_clks_enable(drvdata);
+}
+
+/*
+ * board mute
+ *
+ * The optional mute GPIO silences the outputs without going through
+ * the I2C bus. The codec soft mute is still applied by the core and
+ * serves as the fallback if no GPIO is described. Trigger runs in
+ * atomic context, so it drives a GPIO that can sleep from a work item.
+ */
+static void taudac_mute_work(struct work_struct *work)
+{
+	struct snd_soc_card_drvdata *drvdata = container_of(work,
+			struct snd_soc_card_drvdata, mute_work);
+
+	gpiod_set_value_cansleep(drvdata->mute_gpio,
+			READ_ONCE(drvdata->mute_state));
+}
+
+static void taudac_mute(struct snd_soc_card_drvdata *drvdata, bool mute)
+{
+	if (!drvdata->mute_gpio)
+		return;
+
+	/* a queued change from trigger must not undo this one */
+	WRITE_ONCE(drvdata->mute_state, mute);
+	cancel_work_sync(&drvdata->mute_work);
+	gpiod_set_value_cansleep(drvdata->mute_gpio, mute);
+}
+
+static void taudac_mute_atomic(struct snd_soc_card_drvdata *drvdata,
+		bool mute)
+{
+	if (!drvdata->mute_gpio)
+		return;
+
+	if (!gpiod_cansleep(drvdata->mute_gpio)) {
+		gpiod_set_value(drvdata->mute_gpio, mute);
+		return;
+	}
+
+	WRITE_ONCE(drvdata->mute_state, mute);
+	schedule_work(&drvdata->mute_work);
+}
+
 static const struct reg_default wm8741_reg_updates[] = {
 	/**
 	 * R0..R3 - Attenuation:
@@ -226,14 +480,36 @@ static const struct reg_default wm8741_reg_updates[] = {
 	{0x05, 0x0080},
 };
 
+static int taudac_codecs_update_bits(struct snd_soc_pcm_runtime *rtd,
+		unsigned int reg, unsigned int mask, unsigned int val)
+{
+	int ret, i;
+	struct snd_soc_dai *codec_dai;
+
+	for_each_rtd_codec_dais(rtd, i, codec_dai) {
+		ret = snd_soc_component_update_bits(codec_dai->component,
+				reg, mask, val);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
 static int taudac_codecs_init(struct snd_soc_pcm_runtime *rtd)
 {
 	int ret, i, k;
 	struct snd_soc_dai *codec_dai;
 
-	for_each_rtd_codec_dais(rtd, i, codec_dai) {
-		/* change some codec settings */
-		for (k = 0; k < ARRAY_SIZE(wm8741_reg_updates); k++) {
+	/*
+	 * Both codecs share one I2C bus, so their writes cannot really run
+	 * in parallel. Interleave them instead: each register is written to
+	 * all codecs before moving on to the next one, so both channels walk
+	 * through the same sequence of states at (nearly) the same time.
+	 */
+	for (k = 0; k < ARRAY_SIZE(wm8741_reg_updates); k++) {
+		for_each_rtd_codec_dais(rtd, i, codec_dai) {
+			/* change some codec settings */
 			ret = snd_soc_component_write(codec_dai->component,
 					wm8741_reg_updates[k].reg,
 					wm8741_reg_updates[k].def);
@@ -255,11 +531,11 @@ static void taudac_codecs_shutdown(struct snd_soc_pcm_runtime *rtd)
 	int i;
 	struct snd_soc_dai *codec_dai;
 
+	/* disable codecs - avoid audible glitches */
+	taudac_codecs_update_bits(rtd, WM8741_FORMAT_CONTROL,
+			WM8741_PWDN_MASK, WM8741_PWDN);
+
 	for_each_rtd_codec_dais(rtd, i, codec_dai) {
-		/* disable codecs - avoid audible glitches */
-		snd_soc_component_update_bits(codec_dai->component,
-				WM8741_FORMAT_CONTROL, WM8741_PWDN_MASK,
-				WM8741_PWDN);
 		/* clear codec sysclk - restore rate constrants */
 		snd_soc_dai_set_sysclk(codec_dai, WM8741_SYSCLK, 0,
 				SND_SOC_CLOCK_IN);
@@ -272,14 +548,16 @@ static int taudac_codecs_prepare(struct snd_soc_pcm_runtime *rtd,
 	int ret, i;
 	struct snd_soc_dai *codec_dai;
 
+	/* set codec sysclk - no bus traffic */
 	for_each_rtd_codec_dais(rtd, i, codec_dai) {
-		/* set codec sysclk */
 		ret = snd_soc_dai_set_sysclk(codec_dai,
 				WM8741_SYSCLK, mclk_rate, SND_SOC_CLOCK_IN);
 		if (ret < 0)
 			return ret;
+	}
 
-		/* set codec DAI configuration */
+	/* set codec DAI configuration - back-to-back on both codecs */
+	for_each_rtd_codec_dais(rtd, i, codec_dai) {
 		ret = snd_soc_dai_set_fmt(codec_dai, fmt);
 		if (ret < 0)
 			return ret;
@@ -290,17 +568,99 @@ static int taudac_codecs_prepare(struct snd_soc_pcm_runtime *rtd,
 
 static int taudac_codecs_startup(struct snd_soc_pcm_runtime *rtd)
 {
-	int ret, i;
-	struct snd_soc_dai *codec_dai;
+	/* leave power down on both codecs in consecutive writes */
+	return taudac_codecs_update_bits(rtd, WM8741_FORMAT_CONTROL,
+			WM8741_PWDN_MASK, 0);
+}
 
-	for_each_rtd_codec_dais(rtd, i, codec_dai) {
-		ret = snd_soc_component_update_bits(codec_dai->component,
-				WM8741_FORMAT_CONTROL, WM8741_PWDN_MASK, 0);
-		if (ret < 0)
-			return ret;
+/*
+ * low latency filter policy
+ */
+enum {
+	FILTER_POLICY_OFF,
+	FILTER_POLICY_AUTO,
+	FILTER_POLICY_ALWAYS,
+};
+
+/* streams with a period or buffer time below these use "Auto" filters */
+#define TAUDAC_LL_PERIOD_US	5000
+#define TAUDAC_LL_BUFFER_US	20000
+
+/*
+ * Filter response (FIRSEL) with the shortest group delay for each
+ * oversampling rate, i.e. the minimum phase responses, see the WM8741
+ * datasheet, "Digital Filter Characteristics".
+ */
+static const unsigned int taudac_low_latency_filter[] = {
+	3,	/* fs <= 48kHz:  Response 4 */
+	3,	/* fs <= 96kHz:  Response 4 */
+	2,	/* fs <= 192kHz: Response 3 */
+};
+
+static bool taudac_filter_is_low_latency(
+		struct snd_soc_card_drvdata *drvdata,
+		struct snd_pcm_hw_params *params)
+{
+	u64 rate = params_rate(params);
+
+	switch (drvdata->filter_policy) {
+	case FILTER_POLICY_ALWAYS:
+		return true;
+	case FILTER_POLICY_AUTO:
+		return (u64)params_period_size(params) * USEC_PER_SEC <=
+				TAUDAC_LL_PERIOD_US * rate ||
+		       (u64)params_buffer_size(params) * USEC_PER_SEC <=
+				TAUDAC_LL_BUFFER_US * rate;
+	default:
+		return false;
 	}
+}
 
-	return 0;
+static int taudac_filter_restore(struct snd_soc_pcm_runtime *rtd,
+		struct snd_soc_card_drvdata *drvdata)
+{
+	if (!drvdata->filter_override)
+		return 0;
+
+	drvdata->filter_override = false;
+
+	return taudac_codecs_update_bits(rtd, WM8741_FILTER_CONTROL,
+			WM8741_FIRSEL_MASK,
+			drvdata->user_filter << WM8741_FIRSEL_SHIFT);
+}
+
+static int taudac_filter_select(struct snd_soc_pcm_runtime *rtd,
+		struct snd_soc_card_drvdata *drvdata,
+		struct snd_pcm_hw_params *params)
+{
+	struct snd_soc_component *component =
+			snd_soc_rtd_to_codec(rtd, 0)->component;
+	unsigned int osr, val;
+
+	if (!taudac_filter_is_low_latency(drvdata, params))
+		return taudac_filter_restore(rtd, drvdata);
+
+	/* save the user's choice, it is restored on shutdown */
+	if (!drvdata->filter_override) {
+		val = snd_soc_component_read(component, WM8741_FILTER_CONTROL);
+		drvdata->user_filter = (val & WM8741_FIRSEL_MASK) >>
+				WM8741_FIRSEL_SHIFT;
+		drvdata->filter_override = true;
+	}
+
+	if (params_rate(params) > 96000)
+		osr = 2;
+	else if (params_rate(params) > 48000)
+		osr = 1;
+	else
+		osr = 0;
+
+	dev_dbg(rtd->card->dev, "%s: low latency filter = %u",
+			__func__, taudac_low_latency_filter[osr]);
+
+	return taudac_codecs_update_bits(rtd, WM8741_FILTER_CONTROL,
+			WM8741_FIRSEL_MASK,
+			taudac_low_latency_filter[osr] << WM8741_FIRSEL_SHIFT);
 }
 
 /*
@@ -369,214 +729,990 @@ static int codec_put_enum(struct snd_kcontrol *kcontrol,
 	return 0;
 }
 
-// TODO: Add DE-EMPHASIS control
-
-static const char *codec_att2db_texts[] = {"Off", "On"};
-static const char *codec_dither_texts[] = {"Off", "RPDF", "TPDF", "HPDF"};
-static const char *codec_filter_texts[] = {"Response 1", "Response 2",
-		"Response 3", "Response 4", "Response 5"};
-
-static SOC_ENUM_SINGLE_DECL(codec_att2db_enum,
-		WM8741_VOLUME_CONTROL, WM8741_ATT2DB_SHIFT, codec_att2db_texts);
-static SOC_ENUM_SINGLE_DECL(codec_dither_enum,
-		WM8741_MODE_CONTROL_2, WM8741_DITHER_SHIFT, codec_dither_texts);
-static SOC_ENUM_SINGLE_DECL(codec_filter_enum,
-		WM8741_FILTER_CONTROL, WM8741_FIRSEL_SHIFT, codec_filter_texts);
-
-static const struct snd_kcontrol_new taudac_controls[] = {
-	SOC_ENUM_EXT("Anti-Clipping Mode", codec_att2db_enum,
-			codec_get_enum, codec_put_enum),
-	SOC_ENUM_EXT("Dither", codec_dither_enum,
-			codec_get_enum, codec_put_enum),
-	SOC_ENUM_EXT("Filter", codec_filter_enum,
-			codec_get_enum, codec_put_enum),
-};
-
 /*
- * asoc digital audio interface
+ * While the low latency filter is active, the "Filter" control operates
+ * on the saved user choice, which is restored on shutdown.
  */
-static int taudac_init(struct snd_soc_pcm_runtime *rtd)
+static int codec_filter_get(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
 {
-	int ret;
-	struct snd_soc_card_drvdata *drvdata =
-			snd_soc_card_get_drvdata(rtd->card);
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+	struct soc_enum *e = (struct soc_enum *)kcontrol->private_value;
 
-	ret = taudac_i2s_clks_init(drvdata);
-	if (ret < 0) {
-		dev_err(rtd->card->dev,
-				"Failed to initialize bit clocks: %d\n", ret);
-		return ret;
-	}
+	if (!drvdata->filter_override)
+		return codec_get_enum(kcontrol, ucontrol);
 
-	ret = taudac_codecs_init(rtd);
-	if (ret < 0) {
-		dev_err(rtd->card->dev,
-				"Failed to configure codecs: %d\n", ret);
-		return ret;
-	}
+	ucontrol->value.enumerated.item[0] =
+			snd_soc_enum_val_to_item(e, drvdata->user_filter);
 
 	return 0;
 }
 
-static void taudac_shutdown(struct snd_pcm_substream *substream)
+static int codec_filter_put(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
 {
-	struct snd_soc_pcm_runtime *rtd = substream->private_data;
-	struct snd_soc_card_drvdata *drvdata =
-			snd_soc_card_get_drvdata(rtd->card);
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+	struct soc_enum *e = (struct soc_enum *)kcontrol->private_value;
+	unsigned int *item = ucontrol->value.enumerated.item;
+	unsigned int val;
 
-	taudac_codecs_shutdown(rtd);
-	taudac_i2s_clks_disable(drvdata);
-	taudac_mclk_disable(drvdata);
+	if (!drvdata->filter_override)
+		return codec_put_enum(kcontrol, ucontrol);
+
+	if (item[0] >= e->items)
+		return -EINVAL;
+
+	val = snd_soc_enum_item_to_val(e, item[0]);
+	if (drvdata->user_filter == val)
+		return 0;
+
+	drvdata->user_filter = val;
+
+	return 1;
 }
 
-static int taudac_hw_params(struct snd_pcm_substream *substream,
-		struct snd_pcm_hw_params *params)
+static int taudac_filter_policy_get(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
 {
-	int ret;
-	struct snd_soc_pcm_runtime *rtd = substream->private_data;
-	struct snd_soc_card_drvdata *drvdata =
-			snd_soc_card_get_drvdata(rtd->card);
-	struct snd_soc_dai *cpu_dai = snd_soc_rtd_to_cpu(rtd, 0);
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
 
-	unsigned int mclk_rate, bclk_rate;
-	unsigned int lrclk_rate = params_rate(params);
-	int width = params_width(params);
+	ucontrol->value.enumerated.item[0] = drvdata->filter_policy;
 
-	unsigned int fmt = SND_SOC_DAIFMT_I2S | SND_SOC_DAIFMT_BC_FC;
+	return 0;
+}
 
-	switch (width) {
-	case 16:
-		fmt |= SND_SOC_DAIFMT_IB_NF;
-		break;
-	case 24:
-		width = 32;
-		fallthrough;
-	case 32:
-		fmt |= SND_SOC_DAIFMT_NB_NF;
-		break;
-	default:
-		dev_err(rtd->card->dev, "Bit depth not supported: %d", width);
-		return -EINVAL;
-	}
+static int taudac_filter_policy_put(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+	struct soc_enum *e = (struct soc_enum *)kcontrol->private_value;
+	unsigned int *item = ucontrol->value.enumerated.item;
 
-	switch (lrclk_rate) {
-	case 44100:
-	case 88200:
-	case 176400:
-		mclk_rate = 22579200;
-		break;
-	case 32000:
-	case 48000:
-	case 96000:
-	case 192000:
-		mclk_rate = 24576000;
-		break;
-	default:
-		dev_err(rtd->card->dev, "Sample rate not supported: %d",
-				lrclk_rate);
+	if (item[0] >= e->items)
 		return -EINVAL;
-	}
 
-	bclk_rate = 2 * width * lrclk_rate;
+	if (drvdata->filter_policy == item[0])
+		return 0;
 
-	/* set cpu DAI configuration */
-	ret = snd_soc_dai_set_bclk_ratio(cpu_dai, 2 * width);
-	if (ret < 0)
-		return ret;
+	/* takes effect with the next hw_params */
+	drvdata->filter_policy = item[0];
 
-	ret = snd_soc_dai_set_fmt(cpu_dai, fmt);
-	if (ret < 0)
-		return ret;
+	return 1;
+}
 
-	/* prepare codecs */
-	ret = taudac_codecs_prepare(rtd, mclk_rate, fmt);
-	if (ret < 0)
-		return ret;
+static int taudac_clk_fault_info(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = 0xff;
 
-	/* enable clocks */
-	ret = taudac_mclk_enable(drvdata, mclk_rate);
-	if (ret < 0)
-		return ret;
+	return 0;
+}
 
-	ret = taudac_i2s_clks_set_rate(drvdata, bclk_rate, lrclk_rate);
+static int taudac_clk_fault_get(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+
+	ucontrol->value.integer.value[0] = READ_ONCE(drvdata->clk_fault);
+
+	return 0;
+}
+
+/*
+ * A trim pulls the Si5351 PLL only. The codecs have to get their master
+ * clock from the same PLL, else the bit clocks drift away from it. On
+ * boards clocking the codecs and CLKIN from one oscillator the trim is
+ * not available at all.
+ */
+static bool taudac_clk_trim_supported(struct snd_soc_card_drvdata *drvdata)
+{
+	struct clk *mclk[] = { drvdata->mclk24, drvdata->mclk22 };
+	int ret, i, k;
+
+	/* the routing of the other rate family is only checked on use */
+	for (k = 0; k < ARRAY_SIZE(mclk); k++) {
+		for (i = 0; i < NUM_BCLKS + NUM_LRCLKS; i++) {
+			ret = si5351_clk_trim_check(taudac_i2s_clk(drvdata, i),
+					mclk[k]);
+			if (ret < 0 && ret != -EBUSY)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static int taudac_clk_set_trim(struct snd_soc_card_drvdata *drvdata,
+		int ppb)
+{
+	struct clk *mclk = drvdata->mclk_src ?: drvdata->mclk24;
+	int ret, i;
+
+	/* the nominal rate is always fine */
+	for (i = 0; ppb && i < NUM_BCLKS + NUM_LRCLKS; i++)
+		if (si5351_clk_trim_check(taudac_i2s_clk(drvdata, i), mclk))
+			return -EOPNOTSUPP;
+
+	/* outputs sharing a PLL are trimmed only once */
+	for (i = 0; i < NUM_BCLKS + NUM_LRCLKS; i++) {
+		ret = si5351_clk_set_trim(taudac_i2s_clk(drvdata, i), ppb);
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int taudac_clk_trim_info(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = -SI5351_TRIM_MAX_PPB;
+	uinfo->value.integer.max = SI5351_TRIM_MAX_PPB;
+
+	return 0;
+}
+
+static int taudac_clk_trim_get(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+	int ret, ppb;
+
+	ret = si5351_clk_get_trim(drvdata->bclk[BCLK_CPU], &ppb);
 	if (ret < 0)
 		return ret;
 
-	ret = taudac_i2s_clks_enable(drvdata);
+	ucontrol->value.integer.value[0] = ppb;
+
+	return 0;
+}
+
+static int taudac_clk_trim_put(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+	long ppb = ucontrol->value.integer.value[0];
+	int ret, old;
+
+	if (ppb < -SI5351_TRIM_MAX_PPB || ppb > SI5351_TRIM_MAX_PPB)
+		return -EINVAL;
+
+	ret = si5351_clk_get_trim(drvdata->bclk[BCLK_CPU], &old);
 	if (ret < 0)
 		return ret;
 
-	/* startup codecs */
-	ret = taudac_codecs_startup(rtd);
+	ret = taudac_clk_set_trim(drvdata, ppb);
 	if (ret < 0)
 		return ret;
 
-	dev_dbg(rtd->card->dev, "%s: mclk = %u, bclk = %u, lrclk = %u, width = %d, fmt = 0x%x",
-			__func__, mclk_rate, bclk_rate, lrclk_rate, width, fmt);
+	return old != ppb;
+}
+
+static int taudac_servo_get(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+
+	ucontrol->value.integer.value[0] = drvdata->servo_enabled;
 
 	return 0;
 }
 
-static struct snd_soc_ops taudac_ops = {
-	.hw_params = taudac_hw_params,
-	.shutdown  = taudac_shutdown,
-};
+static int taudac_servo_put(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+	bool enable = !!ucontrol->value.integer.value[0];
+
+	if (drvdata->servo_enabled == enable)
+		return 0;
+
+	/* takes effect with the next stream start */
+	drvdata->servo_enabled = enable;
+
+	return 1;
+}
+
+static int taudac_clk_source_get(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+
+	ucontrol->value.enumerated.item[0] = drvdata->use_mclk_ext;
+
+	return 0;
+}
+
+static int taudac_clk_source_put(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+	struct soc_enum *e = (struct soc_enum *)kcontrol->private_value;
+	unsigned int *item = ucontrol->value.enumerated.item;
+
+	if (item[0] >= e->items)
+		return -EINVAL;
+
+	if (drvdata->use_mclk_ext == !!item[0])
+		return 0;
+
+	/* takes effect with the next hw_params */
+	drvdata->use_mclk_ext = !!item[0];
+
+	return 1;
+}
+
+static int taudac_ext_rate_info(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_info *uinfo)
+{
+	uinfo->type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+	uinfo->count = 1;
+	uinfo->value.integer.min = 0;
+	uinfo->value.integer.max = INT_MAX;
+
+	return 0;
+}
+
+static int taudac_ext_rate_get(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+
+	ucontrol->value.integer.value[0] = clk_get_rate(drvdata->mclk_ext);
+
+	return 0;
+}
 
-SND_SOC_DAILINK_DEFS(taudac,
-	DAILINK_COMP_ARRAY(COMP_CPU("bcm2708-i2s.0")),
-	DAILINK_COMP_ARRAY(COMP_CODEC("wm8741.1-001a", "wm8741"),
-	                   COMP_CODEC("wm8741.1-001b", "wm8741")),
-	DAILINK_COMP_ARRAY(COMP_PLATFORM("bcm2708-i2s.0")));
+static int taudac_ext_lock_get(struct snd_kcontrol *kcontrol,
+		struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_card *card = snd_kcontrol_chip(kcontrol);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+	int status;
+
+	/* only meaningful while the PLLs run off the external clock */
+	if (!drvdata->mclk_enabled ||
+	    drvdata->mclk_src != drvdata->mclk_ext) {
+		ucontrol->value.integer.value[0] = 0;
+		return 0;
+	}
 
-static struct snd_soc_dai_link taudac_dai[] = {
+	status = si5351_clk_get_status(drvdata->bclk[BCLK_CPU]);
+	if (status < 0)
+		return status;
+
+	ucontrol->value.integer.value[0] = (status == 0);
+
+	return 0;
+}
+
+// TODO: Add DE-EMPHASIS control
+
+static const char *codec_att2db_texts[] = {"Off", "On"};
+static const char *codec_dither_texts[] = {"Off", "RPDF", "TPDF", "HPDF"};
+static const char *codec_filter_texts[] = {"Response 1", "Response 2",
+		"Response 3", "Response 4", "Response 5"};
+static const char *taudac_filter_policy_texts[] = {"Off", "Auto", "Always"};
+
+static SOC_ENUM_SINGLE_DECL(codec_att2db_enum,
+		WM8741_VOLUME_CONTROL, WM8741_ATT2DB_SHIFT, codec_att2db_texts);
+static SOC_ENUM_SINGLE_DECL(codec_dither_enum,
+		WM8741_MODE_CONTROL_2, WM8741_DITHER_SHIFT, codec_dither_texts);
+static SOC_ENUM_SINGLE_DECL(codec_filter_enum,
+		WM8741_FILTER_CONTROL, WM8741_FIRSEL_SHIFT, codec_filter_texts);
+static SOC_ENUM_SINGLE_EXT_DECL(taudac_filter_policy_enum,
+		taudac_filter_policy_texts);
+static const char *taudac_clk_source_texts[] = {"Internal", "External"};
+static SOC_ENUM_SINGLE_EXT_DECL(taudac_clk_source_enum,
+		taudac_clk_source_texts);
+
+static const struct snd_kcontrol_new taudac_controls[] = {
+	SOC_ENUM_EXT("Anti-Clipping Mode", codec_att2db_enum,
+			codec_get_enum, codec_put_enum),
+	SOC_ENUM_EXT("Dither", codec_dither_enum,
+			codec_get_enum, codec_put_enum),
+	SOC_ENUM_EXT("Filter", codec_filter_enum,
+			codec_filter_get, codec_filter_put),
+	SOC_ENUM_EXT("Low Latency Filter", taudac_filter_policy_enum,
+			taudac_filter_policy_get, taudac_filter_policy_put),
 	{
-		.name          = "TauDAC I2S",
-		.stream_name   = "TauDAC HiFi",
-		.dai_fmt       = SND_SOC_DAIFMT_I2S |
-				 SND_SOC_DAIFMT_NB_NF |
-				 SND_SOC_DAIFMT_CBS_CFS,
-		.playback_only = true,
-		.ops  = &taudac_ops,
-		.init = taudac_init,
-		SND_SOC_DAILINK_REG(taudac),
+		/* Si5351 status bits of the last clock fault, 0 if none */
+		.iface  = SNDRV_CTL_ELEM_IFACE_MIXER,
+		.name   = "Clock Fault",
+		.access = SNDRV_CTL_ELEM_ACCESS_READ |
+			  SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info   = taudac_clk_fault_info,
+		.get    = taudac_clk_fault_get,
 	},
 };
 
-static struct snd_soc_codec_conf taudac_codec_conf[] = {
+/* only present if the master clock comes from the trimmed PLL */
+static const struct snd_kcontrol_new taudac_trim_controls[] = {
 	{
-		.dlc = COMP_CODEC_CONF("wm8741.1-001a"),
-		.name_prefix = "Left",
+		.iface  = SNDRV_CTL_ELEM_IFACE_MIXER,
+		.name   = "Clock Trim PPB",
+		.access = SNDRV_CTL_ELEM_ACCESS_READWRITE |
+			  SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info   = taudac_clk_trim_info,
+		.get    = taudac_clk_trim_get,
+		.put    = taudac_clk_trim_put,
 	},
+	SOC_SINGLE_BOOL_EXT("Clock Servo", 0,
+			taudac_servo_get, taudac_servo_put),
+};
+
+/* only present with an external reference clock */
+static const struct snd_kcontrol_new taudac_ext_controls[] = {
+	SOC_ENUM_EXT("Clock Source", taudac_clk_source_enum,
+			taudac_clk_source_get, taudac_clk_source_put),
 	{
-		.dlc = COMP_CODEC_CONF("wm8741.1-001b"),
-		.name_prefix = "Right",
+		.iface  = SNDRV_CTL_ELEM_IFACE_MIXER,
+		.name   = "External Clock Rate",
+		.access = SNDRV_CTL_ELEM_ACCESS_READ |
+			  SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info   = taudac_ext_rate_info,
+		.get    = taudac_ext_rate_get,
 	},
+	{
+		.iface  = SNDRV_CTL_ELEM_IFACE_MIXER,
+		.name   = "External Clock Lock",
+		.access = SNDRV_CTL_ELEM_ACCESS_READ |
+			  SNDRV_CTL_ELEM_ACCESS_VOLATILE,
+		.info   = snd_ctl_boolean_mono_info,
+		.get    = taudac_ext_lock_get,
+	},
+};
+
+/*
+ * clock servo
+ *
+ * Disciplines the bit clocks to CLOCK_TAI, which in a networked setup is
+ * kept in sync with the PTP hardware clock by phc2sys or similar. Once a
+ * second the frames played are compared against the TAI time elapsed
+ * since the stream started, and a PI loop steers the Si5351 PLL trim to
+ * null the phase error.
+ */
+static bool taudac_servo_sample(struct snd_soc_card_drvdata *drvdata,
+		u64 *frames, u64 *t, unsigned int *rate)
+{
+	struct snd_pcm_substream *substream;
+	struct snd_pcm_runtime *runtime;
+	snd_pcm_uframes_t pos, hw_ptr, delta;
+	bool ok = false;
+
+	spin_lock_irq(&drvdata->substream_lock);
+	substream = drvdata->substream;
+	if (!substream)
+		goto out;
+
+	snd_pcm_stream_lock(substream);
+	runtime = substream->runtime;
+	if (runtime->state != SNDRV_PCM_STATE_RUNNING)
+		goto unlock;
+
+	/*
+	 * The hw_ptr is only updated once per period, so read the DMA
+	 * position and extend it the way the pcm core does.
+	 */
+	pos = substream->ops->pointer(substream);
+	if (pos >= runtime->buffer_size)
+		goto unlock;
+	hw_ptr = runtime->hw_ptr_base + pos;
+	if (pos < runtime->status->hw_ptr % runtime->buffer_size)
+		hw_ptr += runtime->buffer_size;
+	if (hw_ptr >= runtime->boundary)
+		hw_ptr -= runtime->boundary;
+
+	*t = ktime_get_clocktai_ns();
+
+	if (drvdata->servo_locked) {
+		delta = (hw_ptr >= drvdata->servo_hw_ptr) ?
+				hw_ptr - drvdata->servo_hw_ptr :
+				hw_ptr + runtime->boundary -
+				drvdata->servo_hw_ptr;
+		drvdata->servo_frames += delta;
+	}
+	drvdata->servo_hw_ptr = hw_ptr;
+	*frames = drvdata->servo_frames;
+	*rate = runtime->rate;
+	ok = true;
+unlock:
+	snd_pcm_stream_unlock(substream);
+out:
+	spin_unlock_irq(&drvdata->substream_lock);
+
+	return ok;
+}
+
+static void taudac_servo_work(struct work_struct *work)
+{
+	struct snd_soc_card_drvdata *drvdata = container_of(
+			to_delayed_work(work), struct snd_soc_card_drvdata,
+			servo_work);
+	unsigned int rate;
+	u64 frames, t;
+	s64 err, ppb;
+	int ret;
+
+	if (!taudac_servo_sample(drvdata, &frames, &t, &rate))
+		return;
+
+	if (!drvdata->servo_locked) {
+		drvdata->servo_locked = true;
+		drvdata->servo_frames = 0;
+		drvdata->servo_t0 = t;
+		drvdata->servo_integral = 0;
+		goto next;
+	}
+
+	/* phase error in ns, positive if the clocks run fast */
+	err = mul_u64_u32_div(frames, NSEC_PER_SEC, rate) -
+			(t - drvdata->servo_t0);
+
+	/* a ppb applied for one second moves the phase by one ns */
+	drvdata->servo_integral = clamp_t(s64, drvdata->servo_integral + err,
+			-((s64)SI5351_TRIM_MAX_PPB << TAUDAC_SERVO_KI_SHIFT),
+			(s64)SI5351_TRIM_MAX_PPB << TAUDAC_SERVO_KI_SHIFT);
+	ppb = -((err >> TAUDAC_SERVO_KP_SHIFT) +
+		(drvdata->servo_integral >> TAUDAC_SERVO_KI_SHIFT));
+	ppb = clamp_t(s64, ppb, -SI5351_TRIM_MAX_PPB, SI5351_TRIM_MAX_PPB);
+
+	dev_dbg(drvdata->card->dev, "%s: err = %lld ns, trim = %lld ppb\n",
+			__func__, err, ppb);
+
+	ret = taudac_clk_set_trim(drvdata, ppb);
+	if (ret < 0) {
+		dev_err(drvdata->card->dev, "Clock servo failed: %d\n", ret);
+		return;
+	}
+next:
+	if (READ_ONCE(drvdata->servo_running))
+		schedule_delayed_work(&drvdata->servo_work,
+				msecs_to_jiffies(TAUDAC_SERVO_PERIOD_MS));
+}
+
+/* called from trigger, atomic context */
+static void taudac_servo_start(struct snd_soc_card_drvdata *drvdata)
+{
+	if (!drvdata->servo_enabled || drvdata->servo_running)
+		return;
+
+	WRITE_ONCE(drvdata->servo_running, true);
+	drvdata->servo_locked = false;
+	schedule_delayed_work(&drvdata->servo_work,
+			msecs_to_jiffies(TAUDAC_SERVO_PERIOD_MS));
+}
+
+static void taudac_servo_stop(struct snd_soc_card_drvdata *drvdata)
+{
+	WRITE_ONCE(drvdata->servo_running, false);
+	cancel_delayed_work(&drvdata->servo_work);
+}
+
+/*
+ * asoc digital audio interface
+ */
+static int taudac_init(struct snd_soc_pcm_runtime *rtd)
+{
+	int ret;
+	struct snd_soc_card_drvdata *drvdata =
+			snd_soc_card_get_drvdata(rtd->card);
+
+	/* a register profile comes with the complete clock plan */
+	ret = taudac_clk_profile(drvdata, 24576000);
+	if (ret == -ENOENT || ret == -ENODEV)
+		ret = taudac_i2s_clks_init(drvdata);
+	if (ret < 0) {
+		dev_err(rtd->card->dev,
+				"Failed to initialize bit clocks: %d\n", ret);
+		return ret;
+	}
+
+	ret = taudac_codecs_init(rtd);
+	if (ret < 0) {
+		dev_err(rtd->card->dev,
+				"Failed to configure codecs: %d\n", ret);
+		return ret;
+	}
+
+	if (drvdata->mclk_ext) {
+		ret = snd_soc_add_card_controls(rtd->card, taudac_ext_controls,
+				ARRAY_SIZE(taudac_ext_controls));
+		if (ret < 0)
+			return ret;
+	}
+
+	drvdata->trim_supported = taudac_clk_trim_supported(drvdata);
+	if (drvdata->trim_supported) {
+		ret = snd_soc_add_card_controls(rtd->card, taudac_trim_controls,
+				ARRAY_SIZE(taudac_trim_controls));
+		if (ret < 0)
+			return ret;
+	}
+
+	return 0;
+}
+
+static void taudac_shutdown(struct snd_pcm_substream *substream)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct snd_soc_card_drvdata *drvdata =
+			snd_soc_card_get_drvdata(rtd->card);
+	u64 start = ktime_get_ns(), t;
+
+	spin_lock_irq(&drvdata->substream_lock);
+	drvdata->substream = NULL;
+	spin_unlock_irq(&drvdata->substream_lock);
+
+	/* leave the clocks at their nominal rate for the next stream */
+	taudac_servo_stop(drvdata);
+	cancel_delayed_work_sync(&drvdata->servo_work);
+	if (drvdata->servo_enabled)
+		taudac_clk_set_trim(drvdata, 0);
+
+	taudac_mute(drvdata, true);
+	t = ktime_get_ns();
+	taudac_codecs_shutdown(rtd);
+	trace_taudac_codecs_shutdown(ktime_get_ns() - t, 0);
+	taudac_filter_restore(rtd, drvdata);
+	taudac_hist_add(&drvdata->stats.shutdown, ktime_get_ns() - start);
+
+	/* the clocks are released on autosuspend */
+	pm_runtime_mark_last_busy(rtd->card->dev);
+	pm_runtime_put_autosuspend(rtd->card->dev);
+}
+
+static int taudac_hw_params(struct snd_pcm_substream *substream,
+		struct snd_pcm_hw_params *params)
+{
+	int ret;
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct snd_soc_card_drvdata *drvdata =
+			snd_soc_card_get_drvdata(rtd->card);
+	struct snd_soc_dai *cpu_dai = snd_soc_rtd_to_cpu(rtd, 0);
+	u64 start = ktime_get_ns(), t;
+	bool mclk_off;
+
+	unsigned int mclk_rate, bclk_rate, fmt;
+	unsigned int lrclk_rate = params_rate(params);
+	int width = params_width(params);
+
+	ret = taudac_stream_fmt(width, &fmt);
+	if (ret < 0) {
+		dev_err(rtd->card->dev, "Bit depth not supported: %d", width);
+		return ret;
+	}
+	width = ret;
+
+	mclk_rate = taudac_stream_mclk_rate(lrclk_rate);
+	if (!mclk_rate) {
+		dev_err(rtd->card->dev, "Sample rate not supported: %d",
+				lrclk_rate);
+		return -EINVAL;
+	}
+
+	bclk_rate = 2 * width * lrclk_rate;
+
+	/* set cpu DAI configuration */
+	ret = snd_soc_dai_set_bclk_ratio(cpu_dai, 2 * width);
+	if (ret < 0)
+		return ret;
+
+	ret = snd_soc_dai_set_fmt(cpu_dai, fmt);
+	if (ret < 0)
+		return ret;
+
+	/* prepare codecs */
+	t = ktime_get_ns();
+	ret = taudac_codecs_prepare(rtd, mclk_rate, fmt);
+	trace_taudac_codecs_prepare(ktime_get_ns() - t, ret);
+	if (ret < 0)
+		goto out;
+
+	ret = taudac_filter_select(rtd, drvdata, params);
+	if (ret < 0)
+		goto out;
+
+	/* keep the outputs muted while the clocks are switched */
+	taudac_mute(drvdata, true);
+
+	/*
+	 * Clocks left running by a previous stream are reused as long as
+	 * their rates match. Otherwise they are stopped, so the Si5351
+	 * outputs get phase aligned again when they are re-enabled.
+	 */
+	if (drvdata->mclk_src != taudac_mclk_src(drvdata, mclk_rate)) {
+		if (drvdata->mclk_src)
+			drvdata->stats.family_switches++;
+		taudac_clks_release(drvdata);
+
+		/* a trim may not follow the new master clock */
+		if (drvdata->trim_supported)
+			taudac_clk_set_trim(drvdata, 0);
+
+		ret = taudac_clk_profile(drvdata, mclk_rate);
+		if (ret < 0 && ret != -ENOENT && ret != -ENODEV)
+			goto out;
+	} else if (drvdata->bclk_rate != bclk_rate ||
+		   drvdata->lrclk_rate != lrclk_rate) {
+		taudac_i2s_clks_disable(drvdata);
+	} else if (drvdata->i2s_clks_enabled) {
+		drvdata->stats.hw_params_repeats++;
+	}
+
+	/* enable clocks */
+	mclk_off = !drvdata->mclk_enabled;
+	t = ktime_get_ns();
+	ret = taudac_mclk_enable(drvdata, mclk_rate);
+	t = ktime_get_ns() - t;
+	trace_taudac_mclk_enable(mclk_rate, t, ret);
+	if (ret == 0 && mclk_off)
+		taudac_hist_add(&drvdata->stats.mclk_settle, t);
+	if (ret < 0) {
+		drvdata->stats.clk_enable_failures++;
+		if (drvdata->use_mclk_ext)
+			dev_err(rtd->card->dev,
+					"External clock does not match rate %u\n",
+					lrclk_rate);
+		goto out;
+	}
+
+	t = ktime_get_ns();
+	ret = taudac_i2s_clks_set_rate(drvdata, bclk_rate, lrclk_rate);
+	trace_taudac_i2s_clks_set_rate(bclk_rate, lrclk_rate,
+			ktime_get_ns() - t, ret);
+	if (ret < 0)
+		goto out;
+
+	t = ktime_get_ns();
+	ret = taudac_i2s_clks_enable(drvdata);
+	t = ktime_get_ns() - t;
+	trace_taudac_i2s_clks_enable(t, ret);
+	if (ret < 0) {
+		drvdata->stats.clk_enable_failures++;
+		goto out;
+	}
+	taudac_hist_add(&drvdata->stats.i2s_clks_enable, t);
+
+	/* startup codecs */
+	t = ktime_get_ns();
+	ret = taudac_codecs_startup(rtd);
+	trace_taudac_codecs_startup(ktime_get_ns() - t, ret);
+	if (ret < 0)
+		goto out;
+
+	dev_dbg(rtd->card->dev, "%s: mclk = %u, bclk = %u, lrclk = %u, width = %d, fmt = 0x%x",
+			__func__, mclk_rate, bclk_rate, lrclk_rate, width, fmt);
+out:
+	t = ktime_get_ns() - start;
+	trace_taudac_hw_params(lrclk_rate, width, mclk_rate, t, ret);
+	taudac_hist_add(&drvdata->stats.hw_params, t);
+
+	return ret;
+}
+
+static int taudac_startup(struct snd_pcm_substream *substream)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct snd_soc_card_drvdata *drvdata =
+			snd_soc_card_get_drvdata(rtd->card);
+	int ret;
+
+	ret = pm_runtime_resume_and_get(rtd->card->dev);
+	if (ret < 0)
+		return ret;
+
+	spin_lock_irq(&drvdata->substream_lock);
+	drvdata->substream = substream;
+	spin_unlock_irq(&drvdata->substream_lock);
+
+	return 0;
+}
+
+static int taudac_trigger(struct snd_pcm_substream *substream, int cmd)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct snd_soc_card_drvdata *drvdata =
+			snd_soc_card_get_drvdata(rtd->card);
+
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+	case SNDRV_PCM_TRIGGER_RESUME:
+	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
+		taudac_servo_start(drvdata);
+		taudac_mute_atomic(drvdata, false);
+		break;
+	case SNDRV_PCM_TRIGGER_STOP:
+	case SNDRV_PCM_TRIGGER_SUSPEND:
+	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
+		taudac_servo_stop(drvdata);
+		taudac_mute_atomic(drvdata, true);
+		break;
+	}
+
+	return 0;
+}
+
+static const struct snd_soc_ops taudac_ops = {
+	.startup   = taudac_startup,
+	.hw_params = taudac_hw_params,
+	.trigger   = taudac_trigger,
+	.shutdown  = taudac_shutdown,
 };
 
 /*
- * asoc machine driver
+ * dai link template, copied for each card and completed with the
+ * components found in the device tree
  */
-static struct snd_soc_card taudac_card = {
-	.name         = "TauDAC",
-	.owner        = THIS_MODULE,
-	.dai_link     = taudac_dai,
-	.num_links    = ARRAY_SIZE(taudac_dai),
-	.codec_conf   = taudac_codec_conf,
-	.num_configs  = ARRAY_SIZE(taudac_codec_conf),
-	.controls     = taudac_controls,
-	.num_controls = ARRAY_SIZE(taudac_controls),
+static const struct snd_soc_dai_link taudac_dai_template = {
+	.name          = "TauDAC I2S",
+	.stream_name   = "TauDAC HiFi",
+	.dai_fmt       = SND_SOC_DAIFMT_I2S |
+			 SND_SOC_DAIFMT_NB_NF |
+			 SND_SOC_DAIFMT_CBS_CFS,
+	.playback_only = true,
+	.ops  = &taudac_ops,
+	.init = taudac_init,
+};
+
+/* used for codecs without a sound-name-prefix property */
+static const char * const taudac_codec_prefixes[TAUDAC_NUM_CODECS] = {
+	"Left", "Right",
+};
+
+/*
+ * clock monitoring
+ *
+ * The Si5351 reports loss of lock, loss of signal and device resets.
+ * Any of them corrupts the running stream, so it is stopped with an
+ * xrun and the fault is published through the "Clock Fault" control.
+ */
+static int taudac_clk_notify(struct notifier_block *nb,
+		unsigned long event, void *data)
+{
+	struct snd_soc_card_drvdata *drvdata =
+			container_of(nb, struct snd_soc_card_drvdata, clk_nb);
+	unsigned long flags;
+
+	dev_warn(drvdata->card->dev, "Clock fault: 0x%02lx\n", event);
+
+	WRITE_ONCE(drvdata->clk_fault, event);
+	if (drvdata->clk_fault_kctl)
+		snd_ctl_notify(drvdata->card->snd_card,
+				SNDRV_CTL_EVENT_MASK_VALUE,
+				&drvdata->clk_fault_kctl->id);
+
+	spin_lock_irqsave(&drvdata->substream_lock, flags);
+	if (drvdata->substream)
+		snd_pcm_stop_xrun(drvdata->substream);
+	spin_unlock_irqrestore(&drvdata->substream_lock, flags);
+
+	return NOTIFY_OK;
+}
+
+static void taudac_clk_monitor_init(struct snd_soc_card_drvdata *drvdata)
+{
+	int ret;
+
+	drvdata->clk_fault_kctl = snd_soc_card_get_kcontrol(drvdata->card,
+			"Clock Fault");
+
+	/* all clocks come from one Si5351, the cpu bit clock stands for it */
+	drvdata->clk_nb.notifier_call = taudac_clk_notify;
+	ret = si5351_clk_register_notifier(drvdata->bclk[BCLK_CPU],
+			&drvdata->clk_nb);
+	if (ret == 0)
+		drvdata->clk_nb_registered = true;
+	else if (ret != -ENODEV)
+		dev_warn(drvdata->card->dev,
+				"Failed to monitor clocks: %d\n", ret);
+}
+
+/*
+ * debugfs statistics
+ *
+ * Updated without locking, a reader may see a stream setup half
+ * accounted for.
+ */
+static void taudac_hist_show(struct seq_file *s, const char *name,
+		const struct taudac_hist *hist)
+{
+	int n;
+
+	seq_printf(s, "%s:", name);
+	for (n = 0; n < TAUDAC_HIST_BUCKETS; n++)
+		seq_printf(s, " %u", hist->bucket[n]);
+	seq_putc(s, '\n');
+}
+
+static int taudac_stats_show(struct seq_file *s, void *data)
+{
+	struct snd_soc_card_drvdata *drvdata = s->private;
+	struct taudac_stats *stats = &drvdata->stats;
+
+	seq_puts(s, "# log2 histograms, bucket n: [2^(n-1), 2^n) us\n");
+	taudac_hist_show(s, "hw_params", &stats->hw_params);
+	taudac_hist_show(s, "shutdown", &stats->shutdown);
+	taudac_hist_show(s, "mclk_settle", &stats->mclk_settle);
+	taudac_hist_show(s, "i2s_clks_enable", &stats->i2s_clks_enable);
+	seq_printf(s, "family_switches: %u\n", stats->family_switches);
+	seq_printf(s, "hw_params_repeats: %u\n", stats->hw_params_repeats);
+	seq_printf(s, "clk_enable_failures: %u\n", stats->clk_enable_failures);
+	seq_printf(s, "mclk: %u enables, %u disables, %s\n",
+			stats->mclk_enables, stats->mclk_disables,
+			drvdata->mclk_enabled ? "on" : "off");
+	seq_printf(s, "i2s_clks: %u enables, %u disables, %s\n",
+			stats->i2s_clks_enables, stats->i2s_clks_disables,
+			drvdata->i2s_clks_enabled ? "on" : "off");
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(taudac_stats);
+
+static ssize_t taudac_stats_reset_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct snd_soc_card_drvdata *drvdata = file->private_data;
+
+	memset(&drvdata->stats, 0, sizeof(drvdata->stats));
+	/* keep the enable balance for clocks left running */
+	drvdata->stats.mclk_enables = drvdata->mclk_enabled;
+	drvdata->stats.i2s_clks_enables = drvdata->i2s_clks_enabled;
+
+	return count;
+}
+
+static const struct file_operations taudac_stats_reset_fops = {
+	.open   = simple_open,
+	.write  = taudac_stats_reset_write,
+	.llseek = noop_llseek,
+};
+
+static void taudac_debugfs_init(struct snd_soc_card_drvdata *drvdata)
+{
+	struct dentry *root = drvdata->card->debugfs_card_root;
+
+	if (IS_ERR_OR_NULL(root))
+		return;
+
+	debugfs_create_file("stats", 0444, root, drvdata, &taudac_stats_fops);
+	debugfs_create_file("stats_reset", 0200, root, drvdata,
+			&taudac_stats_reset_fops);
+}
+
+/*
+ * runtime power management
+ */
+static int taudac_runtime_suspend(struct device *dev)
+{
+	struct snd_soc_card *card = dev_get_drvdata(dev);
+
+	taudac_clks_release(snd_soc_card_get_drvdata(card));
+
+	return 0;
+}
+
+static int taudac_runtime_resume(struct device *dev)
+{
+	/* the clocks are enabled on demand in hw_params */
+	return 0;
+}
+
+/*
+ * system power management
+ */
+static int taudac_suspend(struct device *dev)
+{
+	struct snd_soc_card *card = dev_get_drvdata(dev);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+	int ret;
+
+	ret = snd_soc_suspend(dev);
+	if (ret < 0)
+		return ret;
+
+	/* the clock state does not survive a power loss */
+	drvdata->clks_suspended = drvdata->mclk_enabled;
+	taudac_clks_release(drvdata);
+
+	return 0;
+}
+
+static int taudac_resume(struct device *dev)
+{
+	struct snd_soc_card *card = dev_get_drvdata(dev);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+	int ret;
+
+	/*
+	 * A suspended stream is only prepared again, not reconfigured, so
+	 * bring back the clocks it was running with.
+	 */
+	if (drvdata->clks_suspended) {
+		drvdata->clks_suspended = false;
+		ret = taudac_clks_restore(drvdata);
+		if (ret < 0)
+			dev_err(dev, "Failed to restore clocks: %d\n", ret);
+	}
+
+	return snd_soc_resume(dev);
+}
+
+static const struct dev_pm_ops taudac_pm_ops = {
+	.suspend  = pm_sleep_ptr(taudac_suspend),
+	.resume   = pm_sleep_ptr(taudac_resume),
+	.freeze   = pm_sleep_ptr(taudac_suspend),
+	.thaw     = pm_sleep_ptr(taudac_resume),
+	.poweroff = pm_sleep_ptr(snd_soc_poweroff),
+	.restore  = pm_sleep_ptr(taudac_resume),
+	RUNTIME_PM_OPS(taudac_runtime_suspend, taudac_runtime_resume, NULL)
 };
 
 /*
  * platform device driver
  */
-static int taudac_set_dai(struct device_node *np)
+static void taudac_of_node_put(void *data)
 {
-	int i;
+	of_node_put(data);
+}
+
+static int taudac_set_dai(struct device *dev, struct snd_soc_card *card)
+{
+	int i, ret;
 
+	struct device_node *np = dev->of_node;
 	struct device_node *i2s_node;
-	struct device_node *i2c_nodes[ARRAY_SIZE(taudac_codec_conf)];
-	struct snd_soc_dai_link *dai = &taudac_dai[0];
+	struct device_node *i2c_node;
+	struct snd_soc_dai_link *dai;
+	struct snd_soc_dai_link_component *comp;
+	struct snd_soc_codec_conf *conf;
+
+	dai = devm_kmemdup(dev, &taudac_dai_template, sizeof(*dai),
+			GFP_KERNEL);
+	/* cpu, platform and codecs */
+	comp = devm_kcalloc(dev, 2 + TAUDAC_NUM_CODECS, sizeof(*comp),
+			GFP_KERNEL);
+	conf = devm_kcalloc(dev, TAUDAC_NUM_CODECS, sizeof(*conf),
+			GFP_KERNEL);
+	if (dai == NULL || comp == NULL || conf == NULL)
+		return -ENOMEM;
 
 	/* dais */
 	i2s_node = of_parse_phandle(np, "taudac,i2s-controller", 0);
@@ -584,19 +1720,46 @@ static int taudac_set_dai(struct device_node *np)
 	if (i2s_node == NULL)
 		return -EINVAL;
 
-	dai->cpus->dai_name = NULL;
+	/* the links refer to the nodes for as long as the card exists */
+	ret = devm_add_action_or_reset(dev, taudac_of_node_put, i2s_node);
+	if (ret)
+		return ret;
+
+	dai->cpus = &comp[0];
+	dai->num_cpus = 1;
 	dai->cpus->of_node = i2s_node;
-	dai->platforms->name = NULL;
+	dai->platforms = &comp[1];
+	dai->num_platforms = 1;
 	dai->platforms->of_node = i2s_node;
+	dai->codecs = &comp[2];
+	dai->num_codecs = TAUDAC_NUM_CODECS;
+
+	card->dai_link = dai;
+	card->num_links = 1;
+	card->codec_conf = conf;
+	card->num_configs = 0;
 
-	for (i = 0; i < ARRAY_SIZE(i2c_nodes); i++) {
-		i2c_nodes[i] = of_parse_phandle(np, "taudac,codecs", i);
+	for (i = 0; i < TAUDAC_NUM_CODECS; i++) {
+		i2c_node = of_parse_phandle(np, "taudac,codecs", i);
 
-		if (i2c_nodes[i] == NULL)
+		if (i2c_node == NULL)
 			return -EINVAL;
 
-		dai->codecs[i].name = NULL;
-		dai->codecs[i].of_node = i2c_nodes[i];
+		ret = devm_add_action_or_reset(dev, taudac_of_node_put,
+				i2c_node);
+		if (ret)
+			return ret;
+
+		dai->codecs[i].of_node = i2c_node;
+		dai->codecs[i].dai_name = "wm8741";
+
+		/* a prefix given in the device tree takes precedence */
+		if (of_property_present(i2c_node, "sound-name-prefix"))
+			continue;
+
+		conf[card->num_configs].dlc.of_node = i2c_node;
+		conf[card->num_configs].name_prefix = taudac_codec_prefixes[i];
+		card->num_configs++;
 	}
 
 	return 0;
@@ -621,6 +1784,11 @@ static int taudac_set_clk(struct device *dev,
 	if (IS_ERR(drvdata->mclk_gate))
 		return -EINVAL;
 
+	/* optional external reference, a further parent of the mclk mux */
+	drvdata->mclk_ext = devm_clk_get_optional(dev, "mclk-ext");
+	if (IS_ERR(drvdata->mclk_ext))
+		return PTR_ERR(drvdata->mclk_ext);
+
 	drvdata->bclk[BCLK_CPU] = devm_clk_get(dev, "bclk-cpu");
 	if (IS_ERR(drvdata->bclk[BCLK_CPU]))
 		return -EPROBE_DEFER;
@@ -648,26 +1816,96 @@ static int taudac_set_clk(struct device *dev,
 	return 0;
 }
 
+static void taudac_clk_release(void *data)
+{
+	struct snd_soc_card_drvdata *drvdata = data;
+	int i;
+
+	for (i = 0; i < NUM_BCLKS + NUM_LRCLKS; i++)
+		si5351_clk_release(taudac_i2s_clk(drvdata, i),
+				drvdata->card->dev);
+}
+
+/*
+ * The profile, trim and skew state is kept by the Si5351 driver per
+ * chip, so a Si5351 clocks one card only.
+ */
+static int taudac_clk_claim(struct device *dev,
+		struct snd_soc_card_drvdata *drvdata)
+{
+	int ret, i;
+
+	for (i = 0; i < NUM_BCLKS + NUM_LRCLKS; i++) {
+		ret = si5351_clk_claim(taudac_i2s_clk(drvdata, i), dev);
+		if (ret < 0) {
+			while (i--)
+				si5351_clk_release(taudac_i2s_clk(drvdata, i),
+						dev);
+			return ret;
+		}
+	}
+
+	return devm_add_action_or_reset(dev, taudac_clk_release, drvdata);
+}
+
+/*
+ * optional properties taudac,bclk-skew-ps and taudac,lrclk-skew-ps :
+ * <cpu dacl dacr> delays compensating the board skew between the
+ * outputs, applied by the Si5351 whenever the clocks are started
+ */
+static int taudac_set_clk_skew(struct device *dev,
+		struct snd_soc_card_drvdata *drvdata)
+{
+	static const char * const props[] = {
+		"taudac,bclk-skew-ps", "taudac,lrclk-skew-ps",
+	};
+	u32 skew[NUM_BCLKS];
+	int ret, i, k;
+
+	for (i = 0; i < ARRAY_SIZE(props); i++) {
+		if (of_property_read_u32_array(dev->of_node, props[i], skew,
+				ARRAY_SIZE(skew)))
+			continue;
+
+		for (k = 0; k < ARRAY_SIZE(skew); k++) {
+			ret = si5351_clk_set_phase_ps(
+					taudac_i2s_clk(drvdata,
+						i * NUM_BCLKS + k), skew[k]);
+			if (ret < 0)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
 static int taudac_probe(struct platform_device *pdev)
 {
 	int ret;
-	struct device_node *np;
+	struct snd_soc_card *card;
 	struct snd_soc_card_drvdata *drvdata;
 
-	taudac_card.dev = &pdev->dev;
-
 	drvdata = devm_kzalloc(&pdev->dev, sizeof(*drvdata), GFP_KERNEL);
 	if (drvdata == NULL)
 		return -ENOMEM;
 
-	np = pdev->dev.of_node;
-	if (np == NULL) {
+	card = devm_kzalloc(&pdev->dev, sizeof(*card), GFP_KERNEL);
+	if (card == NULL)
+		return -ENOMEM;
+
+	if (pdev->dev.of_node == NULL) {
 		dev_err(&pdev->dev, "Device tree node not found\n");
 		return -ENODEV;
 	}
 
+	card->dev          = &pdev->dev;
+	card->name         = "TauDAC";
+	card->owner        = THIS_MODULE;
+	card->controls     = taudac_controls;
+	card->num_controls = ARRAY_SIZE(taudac_controls);
+
 	/* set dai */
-	ret = taudac_set_dai(np);
+	ret = taudac_set_dai(&pdev->dev, card);
 	if (ret != 0) {
 		dev_err(&pdev->dev, "Setting dai failed: %d\n", ret);
 		return ret;
@@ -681,23 +1919,75 @@ static int taudac_probe(struct platform_device *pdev)
 		return ret;
 	}
 
+	drvdata->card = card;
+	ret = taudac_clk_claim(&pdev->dev, drvdata);
+	if (ret != 0) {
+		dev_err(&pdev->dev, "Claiming the Si5351 failed: %d\n", ret);
+		return ret;
+	}
+
+	ret = taudac_set_clk_skew(&pdev->dev, drvdata);
+	if (ret != 0) {
+		dev_err(&pdev->dev, "Setting clock skew failed: %d\n", ret);
+		return ret;
+	}
+
+	/* optional board mute, muted until a stream is started */
+	drvdata->mute_gpio = devm_gpiod_get_optional(&pdev->dev, "mute",
+			GPIOD_OUT_HIGH);
+	if (IS_ERR(drvdata->mute_gpio)) {
+		ret = PTR_ERR(drvdata->mute_gpio);
+		if (ret != -EPROBE_DEFER)
+			dev_err(&pdev->dev, "Getting mute gpio failed: %d\n",
+					ret);
+		return ret;
+	}
+
+	/* clocks are off until the first stream opens */
+	pm_runtime_set_autosuspend_delay(&pdev->dev,
+			TAUDAC_AUTOSUSPEND_DELAY_MS);
+	pm_runtime_use_autosuspend(&pdev->dev);
+	pm_runtime_enable(&pdev->dev);
+
 	/* register card */
-	snd_soc_card_set_drvdata(&taudac_card, drvdata);
-	snd_soc_of_parse_card_name(&taudac_card, "taudac,model");
-	ret = snd_soc_register_card(&taudac_card);
+	spin_lock_init(&drvdata->substream_lock);
+	INIT_DELAYED_WORK(&drvdata->servo_work, taudac_servo_work);
+	INIT_WORK(&drvdata->mute_work, taudac_mute_work);
+	snd_soc_card_set_drvdata(card, drvdata);
+	snd_soc_of_parse_card_name(card, "taudac,model");
+	ret = snd_soc_register_card(card);
 	if (ret != 0) {
 		if (ret != -EPROBE_DEFER)
 			dev_err(&pdev->dev, "snd_soc_register_card() failed: %d\n",
 					ret);
+		pm_runtime_disable(&pdev->dev);
+		pm_runtime_dont_use_autosuspend(&pdev->dev);
 		return ret;
 	}
 
+	taudac_clk_monitor_init(drvdata);
+	taudac_debugfs_init(drvdata);
+
 	return ret;
 }
 
 static void taudac_remove(struct platform_device *pdev)
 {
-	snd_soc_unregister_card(&taudac_card);
+	struct snd_soc_card *card = platform_get_drvdata(pdev);
+	struct snd_soc_card_drvdata *drvdata = snd_soc_card_get_drvdata(card);
+
+	if (drvdata->clk_nb_registered)
+		si5351_clk_unregister_notifier(drvdata->bclk[BCLK_CPU],
+				&drvdata->clk_nb);
+
+	snd_soc_unregister_card(card);
+	cancel_work_sync(&drvdata->mute_work);
+
+	pm_runtime_disable(&pdev->dev);
+	pm_runtime_dont_use_autosuspend(&pdev->dev);
+	if (!pm_runtime_status_suspended(&pdev->dev))
+		taudac_clks_release(drvdata);
+	pm_runtime_set_suspended(&pdev->dev);
 }
 
 static const struct of_device_id taudac_of_match[] = {
@@ -711,6 +2001,7 @@ static struct platform_driver taudac_driver = {
 		.name  = "snd-soc-taudac",
 		.owner = THIS_MODULE,
 		.of_match_table = taudac_of_match,
+		.pm    = pm_ptr(&taudac_pm_ops),
 	},
 	.probe  = taudac_probe,
 	.remove = taudac_remove,
@@ -0,0 +1,8 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* userspace stand-in for the kernel errno header, also used by libc */
+#ifndef _BENCH_LINUX_ERRNO_H
+#define _BENCH_LINUX_ERRNO_H
+
+#include <asm/errno.h>
+
+#endif /* _BENCH_LINUX_ERRNO_H */
@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* userspace stand-in for the rounding helpers of the kernel */
+#ifndef _BENCH_LINUX_MATH_H
+#define _BENCH_LINUX_MATH_H
+
+#define DIV_ROUND_CLOSEST(x, divisor)	(((x) + ((divisor) / 2)) / (divisor))
+
+#define abs_diff(a, b)	((a) > (b) ? (a) - (b) : (b) - (a))
+
+#endif /* _BENCH_LINUX_MATH_H */
@@ -0,0 +1,21 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* userspace stand-in for the 64-bit division helpers of the kernel */
+#ifndef _BENCH_LINUX_MATH64_H
+#define _BENCH_LINUX_MATH64_H
+
+#include <linux/types.h>
+
+/* divides n in place and returns the remainder */
+#define do_div(n, base) ({				\
+	u32 __base = (base);				\
+	u32 __rem = (n) % __base;			\
+	(n) /= __base;					\
+	__rem;						\
+})
+
+static inline u64 div64_u64(u64 dividend, u64 divisor)
+{
+	return dividend / divisor;
+}
+
+#endif /* _BENCH_LINUX_MATH64_H */
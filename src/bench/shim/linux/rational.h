@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * userspace copy of rational_best_approximation() from lib/math/rational.c
+ * of the kernel
+ */
+#ifndef _BENCH_LINUX_RATIONAL_H
+#define _BENCH_LINUX_RATIONAL_H
+
+#include <limits.h>
+
+static inline void rational_best_approximation(
+	unsigned long given_numerator, unsigned long given_denominator,
+	unsigned long max_numerator, unsigned long max_denominator,
+	unsigned long *best_numerator, unsigned long *best_denominator)
+{
+	unsigned long n, d, n0, d0, n1, d1, n2, d2;
+
+	n = given_numerator;
+	d = given_denominator;
+	n0 = d1 = 0;
+	n1 = d0 = 1;
+
+	for (;;) {
+		unsigned long dp, a;
+
+		if (d == 0)
+			break;
+
+		dp = d;
+		a = n / d;
+		d = n % d;
+		n = dp;
+
+		n2 = n0 + a * n1;
+		d2 = d0 + a * d1;
+
+		if ((n2 > max_numerator) || (d2 > max_denominator)) {
+			unsigned long t = ULONG_MAX;
+
+			if (d1)
+				t = (max_denominator - d0) / d1;
+			if (n1 && (max_numerator - n0) / n1 < t)
+				t = (max_numerator - n0) / n1;
+
+			/* the semi-convergent, if closer than the convergent */
+			if (!d1 || 2u * t > a ||
+			    (2u * t == a && d0 * dp > d1 * d)) {
+				n1 = n0 + t * n1;
+				d1 = d0 + t * d1;
+			}
+			break;
+		}
+		n0 = n1;
+		n1 = n2;
+		d0 = d1;
+		d1 = d2;
+	}
+	*best_numerator = n1;
+	*best_denominator = d1;
+}
+
+#endif /* _BENCH_LINUX_RATIONAL_H */
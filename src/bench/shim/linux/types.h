@@ -0,0 +1,14 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* userspace stand-in for the kernel types used by the shared headers */
+#ifndef _BENCH_LINUX_TYPES_H
+#define _BENCH_LINUX_TYPES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#endif /* _BENCH_LINUX_TYPES_H */
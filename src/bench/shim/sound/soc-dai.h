@@ -0,0 +1,11 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/* userspace stand-in for the DAI format bits, values as in the kernel */
+#ifndef _BENCH_SOUND_SOC_DAI_H
+#define _BENCH_SOUND_SOC_DAI_H
+
+#define SND_SOC_DAIFMT_I2S		1
+#define SND_SOC_DAIFMT_NB_NF		(0 << 8)
+#define SND_SOC_DAIFMT_IB_NF		(3 << 8)
+#define SND_SOC_DAIFMT_BC_FC		(4 << 12)
+
+#endif /* _BENCH_SOUND_SOC_DAI_H */
@@ -0,0 +1,221 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Host benchmark of the TauDAC driver helpers that do no hardware access
+ *
+ * Built as a plain userspace program by "make bench" in src/, with the
+ * shim headers standing in for the few kernel types and helpers used.
+ * Prints the time per call of the Si5351 parameter math and rate solvers,
+ * the WM8741 volume mapping and the stream format decisions, and the
+ * register bytes one call would put on the bus.
+ *
+ * Usage: taudac_bench [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <linux/types.h>
+
+#include "clk-si5351.h"
+#include "si5351_params.h"
+#include "taudac_stream.h"
+#include "wm8741_volume.h"
+
+#define ARRAY_SIZE(a)	(sizeof(a) / sizeof((a)[0]))
+
+/*
+ * PLL plans of the card: a master clock output runs its PLL at the largest
+ * multiple of MCLK in the VCO range, off a 25 or 27 MHz crystal, and the
+ * I2S clocks run theirs at 31 * CLKIN, with MCLK on CLKIN.
+ */
+struct plan {
+	unsigned long ref;
+	unsigned long vco;
+	/* feedback divider a + b/c */
+	unsigned long a, b, c;
+};
+
+static const struct plan plans[] = {
+	{ 25000000, 880588800, 35, 3493, 15625 },	/* 39 * 22.5792 MHz */
+	{ 25000000, 884736000, 35, 1217, 3125 },	/* 36 * 24.576 MHz */
+	{ 27000000, 880588800, 32, 384, 625 },		/* 39 * 22.5792 MHz */
+	{ 27000000, 884736000, 32, 96, 125 },		/* 36 * 24.576 MHz */
+	{ 22579200, 699955200, 31, 0, 1 },		/* 31 * 22.5792 MHz */
+	{ 24576000, 761856000, 31, 0, 1 },		/* 31 * 24.576 MHz */
+};
+
+static const unsigned long mclks[] = { 22579200, 24576000 };
+
+static const unsigned int rates[] = {
+	32000, 44100, 48000, 88200, 96000, 176400, 192000,
+};
+
+static const int widths[] = { 16, 24, 32 };
+
+/* keeps the compiler from dropping the calls */
+static volatile unsigned long sink;
+
+struct bench {
+	const char *name;
+	/* register bytes on the bus per call */
+	unsigned int reg_bytes;
+	void (*run)(unsigned long n);
+};
+
+static void bench_encode(unsigned long n)
+{
+	struct si5351_parameters params;
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		const struct plan *p = &plans[i % ARRAY_SIZE(plans)];
+
+		si5351_params_encode(&params, p->a, p->b, p->c);
+		sink += params.p1;
+	}
+}
+
+static void bench_encode_pack(unsigned long n)
+{
+	struct si5351_parameters params;
+	u8 buf[SI5351_PARAMETERS_LENGTH];
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		const struct plan *p = &plans[i % ARRAY_SIZE(plans)];
+
+		si5351_params_encode(&params, p->a, p->b, p->c);
+		si5351_params_pack(&params, buf);
+		sink += buf[4];
+	}
+}
+
+static void bench_unpack(unsigned long n)
+{
+	static const u8 buf[SI5351_PARAMETERS_LENGTH] = {
+		0x3d, 0x09, 0x00, 0x0c, 0x73, 0x00, 0x16, 0xf5,
+	};
+	struct si5351_parameters params;
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		si5351_params_unpack(buf, &params);
+		sink += params.p2;
+	}
+}
+
+/* what the PLL determine_rate computes for each plan */
+static void bench_pll_calc(unsigned long n)
+{
+	struct si5351_parameters params;
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		const struct plan *p = &plans[i % ARRAY_SIZE(plans)];
+
+		sink += si5351_pll_calc(&params, p->vco, p->ref);
+	}
+}
+
+/* a master clock output setting its PLL, and an I2S clock that cannot */
+static void bench_msynth_calc(unsigned long n)
+{
+	struct si5351_parameters params;
+	unsigned long i, mclk, vco;
+	int divby4;
+
+	for (i = 0; i < n; i++) {
+		mclk = mclks[i % ARRAY_SIZE(mclks)];
+		if (i & 1) {
+			sink += si5351_msynth_calc(&params, &divby4, 0, mclk,
+						   &vco, true);
+		} else {
+			vco = 31 * mclk;
+			sink += si5351_msynth_calc(&params, &divby4, 2,
+						   mclk / 8, &vco, false);
+		}
+	}
+}
+
+/* the R divider of each LRCLK from the I2S multisynth at MCLK / 8 */
+static void bench_rdiv(unsigned long n)
+{
+	unsigned long i;
+
+	for (i = 0; i < n; i++)
+		sink += si5351_rdiv_closest(rates[i % ARRAY_SIZE(rates)],
+					    mclks[i % ARRAY_SIZE(mclks)] / 8);
+}
+
+/* a volume control put and get, both channels */
+static void bench_volume(unsigned long n)
+{
+	unsigned int lsb, msb;
+	unsigned long i;
+
+	for (i = 0; i < n; i++) {
+		wm8741_volume_to_regs(i & 0x3ff, 0x3ff, true, 5, &lsb, &msb);
+		sink += wm8741_volume_from_regs(lsb, msb, 0x3ff, true, 5);
+	}
+}
+
+/* the decisions taudac_hw_params takes before touching any clock */
+static void bench_stream(unsigned long n)
+{
+	unsigned int fmt;
+	unsigned long i;
+	int slot;
+
+	for (i = 0; i < n; i++) {
+		slot = taudac_stream_fmt(widths[i % ARRAY_SIZE(widths)], &fmt);
+		sink += slot + fmt +
+			taudac_stream_mclk_rate(rates[i % ARRAY_SIZE(rates)]);
+	}
+}
+
+static const struct bench benches[] = {
+	{ "si5351_params_encode", 0, bench_encode },
+	{ "si5351_params_encode+pack", SI5351_PARAMETERS_LENGTH,
+	  bench_encode_pack },
+	{ "si5351_params_unpack", SI5351_PARAMETERS_LENGTH, bench_unpack },
+	{ "si5351_pll_calc", 0, bench_pll_calc },
+	{ "si5351_msynth_calc", 0, bench_msynth_calc },
+	{ "si5351_rdiv_closest", 0, bench_rdiv },
+	/* 7-bit register, 9-bit value: LSB and MSB writes of 2 bytes */
+	{ "wm8741_volume_to/from_regs", 4, bench_volume },
+	{ "taudac_stream_fmt+mclk_rate", 0, bench_stream },
+};
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long n = 10000000;
+	unsigned long long t;
+	unsigned int i;
+
+	if (argc > 1)
+		n = strtoul(argv[1], NULL, 0);
+	if (!n) {
+		fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	printf("%-30s %12s %10s %10s\n", "helper", "calls", "ns/op",
+	       "reg bytes");
+	for (i = 0; i < ARRAY_SIZE(benches); i++) {
+		t = now_ns();
+		benches[i].run(n);
+		t = now_ns() - t;
+
+		printf("%-30s %12lu %10.2f %10u\n", benches[i].name, n,
+		       (double)t / n, benches[i].reg_bytes);
+	}
+
+	return 0;
+}
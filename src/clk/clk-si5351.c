@@ -16,34 +16,66 @@
 #include <linux/kernel.h>
 #include <linux/clk.h>
 #include <linux/clk-provider.h>
+#include <linux/ctype.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/err.h>
 #include <linux/errno.h>
-#include <linux/rational.h>
+#include <linux/firmware.h>
+#include <linux/gpio/consumer.h>
 #include <linux/i2c.h>
+#include <linux/interrupt.h>
+#include <linux/list.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
 #include <linux/of.h>
 #include <linux/platform_data/si5351.h>
+#include <linux/pm_runtime.h>
+#include <linux/property.h>
 #include <linux/regmap.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/string.h>
+#include <linux/workqueue.h>
 #include <asm/div64.h>
 
 #include "clk-si5351.h"
+#include "si5351_params.h"
+#include "taudac_regmap_stats.h"
 
-struct si5351_driver_data;
+#define CREATE_TRACE_POINTS
+#define TAUDAC_TRACE_SI5351
+#include "taudac_trace.h"
 
-struct si5351_parameters {
-	unsigned long	p1;
-	unsigned long	p2;
-	unsigned long	p3;
-	int		valid;
-};
+#define SI5351_AUTOSUSPEND_DELAY_MS	5000
+
+#define SI5351_MAX_PROFILES		4
+#define SI5351_NUM_REGS			(SI5351_MAX_REGISTER + 1)
+
+static unsigned int status_poll_ms;
+module_param(status_poll_ms, uint, 0444);
+MODULE_PARM_DESC(status_poll_ms,
+		 "Poll the status for loss of lock/signal if no irq is wired, in ms (0 = off)");
+
+struct si5351_driver_data;
 
 struct si5351_hw_data {
 	struct clk_hw			hw;
 	struct si5351_driver_data	*drvdata;
 	struct si5351_parameters	params;
 	unsigned char			num;
+	/* rate asked for in the last determine_rate, for clk_plan */
+	unsigned long			req_rate;
+	/* multisynth parameters left for the clkout set_rate to write */
+	bool				params_pending;
+	bool				divby4;
+};
+
+/* register values from a firmware file, to be written as they are */
+struct si5351_profile {
+	u8		val[SI5351_NUM_REGS];
+	DECLARE_BITMAP(mask, SI5351_NUM_REGS);
 };
 
 struct si5351_driver_data {
@@ -62,8 +94,61 @@ struct si5351_driver_data {
 	struct si5351_hw_data	*msynth;
 	struct si5351_hw_data	*clkout;
 	size_t			num_clkout;
+
+	struct gpio_desc	*oeb_gpio;
+	u8			oeb_mask;
+	unsigned int		oeb_count;
+	unsigned int		oeb_hold;
+	bool			oeb_on;
+	/* oeb_mutex for a sleeping OEB GPIO, oeb_spinlock otherwise */
+	struct mutex		oeb_mutex;
+	spinlock_t		oeb_spinlock;
+
+	bool			needs_relock;
+
+	/* PLL resets collected while the initial rates are set */
+	bool			defer_pll_reset;
+	u8			pll_reset_pending;
+	/* LOL bits of PLLs relocking after an intentional reset */
+	u8			lol_settling;
+	/* CLKIN feeds a PLL in use, so its loss is reported */
+	bool			los_armed;
+	/* status interrupt, 0 if polled */
+	int			irq;
+
+	/* Si5351B VCXO absolute pull range, in ppm */
+	unsigned int		vcxo_apr;
+
+	/*
+	 * clk0..5 phase offsets, applied with the next PLL reset. The lock
+	 * is also taken by set_rate, so a phase change set outside of the
+	 * clk framework does not interleave with a retune.
+	 */
+	struct mutex		phase_lock;
+	u32			phase_ps[6];
+
+	struct si5351_profile	*profiles;
+	unsigned int		num_profiles;
+
+	/* PLL parameters as set by set_rate, and the trim applied to them */
+	struct mutex		trim_lock;
+	struct si5351_parameters pll_nominal[2];
+	int			pll_trim[2];
+
+	struct list_head	node;
+	struct blocking_notifier_head notifier;
+	/* consumer owning the profile, trim and phase state, one per chip */
+	struct device		*owner;
+	struct delayed_work	status_work;
+
+	struct taudac_regmap_stats *i2c_stats;
+	struct dentry		*debugfs;
 };
 
+/* all probed instances, to map consumer clocks back to their chip */
+static LIST_HEAD(si5351_instances);
+static DEFINE_MUTEX(si5351_instances_lock);
+
 static const char * const si5351_input_names[] = {
 	"xtal", "clkin"
 };
@@ -110,7 +195,14 @@ static inline int si5351_reg_write(struct si5351_driver_data *drvdata,
 static inline int si5351_bulk_write(struct si5351_driver_data *drvdata,
 				    u8 reg, u8 count, const u8 *buf)
 {
-	return regmap_raw_write(drvdata->regmap, reg, buf, count);
+	u64 t = ktime_get_ns();
+	int ret;
+
+	ret = regmap_raw_write(drvdata->regmap, reg, buf, count);
+	trace_si5351_burst(&drvdata->client->dev, reg, count,
+			   ktime_get_ns() - t, ret);
+
+	return ret;
 }
 
 static inline int si5351_set_bits(struct si5351_driver_data *drvdata,
@@ -138,14 +230,12 @@ static void si5351_read_parameters(struct si5351_driver_data *drvdata,
 		params->p1 = buf[0];
 		params->p2 = 0;
 		params->p3 = 1;
+		params->valid = 1;
 		break;
 	default:
 		si5351_bulk_read(drvdata, reg, SI5351_PARAMETERS_LENGTH, buf);
-		params->p1 = ((buf[2] & 0x03) << 16) | (buf[3] << 8) | buf[4];
-		params->p2 = ((buf[5] & 0x0f) << 16) | (buf[6] << 8) | buf[7];
-		params->p3 = ((buf[5] & 0xf0) << 12) | (buf[0] << 8) | buf[1];
+		si5351_params_unpack(buf, params);
 	}
-	params->valid = 1;
 }
 
 static void si5351_write_parameters(struct si5351_driver_data *drvdata,
@@ -160,21 +250,87 @@ static void si5351_write_parameters(struct si5351_driver_data *drvdata,
 		si5351_reg_write(drvdata, reg, buf[0]);
 		break;
 	default:
-		buf[0] = ((params->p3 & 0x0ff00) >> 8) & 0xff;
-		buf[1] = params->p3 & 0xff;
+		si5351_params_pack(params, buf);
 		/* save rdiv and divby4 */
-		buf[2] = si5351_reg_read(drvdata, reg + 2) & ~0x03;
-		buf[2] |= ((params->p1 & 0x30000) >> 16) & 0x03;
-		buf[3] = ((params->p1 & 0x0ff00) >> 8) & 0xff;
-		buf[4] = params->p1 & 0xff;
-		buf[5] = ((params->p3 & 0xf0000) >> 12) |
-			((params->p2 & 0xf0000) >> 16);
-		buf[6] = ((params->p2 & 0x0ff00) >> 8) & 0xff;
-		buf[7] = params->p2 & 0xff;
+		buf[2] |= si5351_reg_read(drvdata, reg + 2) & ~0x03;
 		si5351_bulk_write(drvdata, reg, SI5351_PARAMETERS_LENGTH, buf);
 	}
 }
 
+/*
+ * An intentional PLL reset drops the lock for a moment, which latches LOL
+ * in the sticky interrupt status. The status monitor skips the PLLs until
+ * they are locked again, and their sticky bits are cleared then.
+ */
+static u8 si5351_pll_reset_to_lol(u8 reset)
+{
+	return ((reset & SI5351_PLL_RESET_A) ? SI5351_STATUS_LOL_A : 0) |
+	       ((reset & SI5351_PLL_RESET_B) ? SI5351_STATUS_LOL_B : 0);
+}
+
+static void _si5351_pll_reset(struct si5351_driver_data *drvdata, u8 reset)
+{
+	WRITE_ONCE(drvdata->lol_settling,
+		   drvdata->lol_settling | si5351_pll_reset_to_lol(reset));
+	si5351_reg_write(drvdata, SI5351_PLL_RESET, reset);
+}
+
+static int _si5351_pll_settle(struct si5351_driver_data *drvdata, u8 reset)
+{
+	u8 lol = si5351_pll_reset_to_lol(reset);
+	unsigned int v;
+	int err;
+
+	err = regmap_read_poll_timeout(drvdata->regmap, SI5351_DEVICE_STATUS,
+				       v, !(v & lol), 100, 20000);
+	/* a write of 0 clears a sticky bit, 1 leaves it alone */
+	if (!err)
+		si5351_reg_write(drvdata, SI5351_INTERRUPT_STATUS, (u8)~lol);
+	WRITE_ONCE(drvdata->lol_settling, drvdata->lol_settling & ~lol);
+
+	return err;
+}
+
+static void _si5351_plls_in_use(struct si5351_driver_data *drvdata,
+				u8 *reset, u8 *lol);
+
+/*
+ * Loss of CLKIN only matters while a PLL in use runs off it. Consumers
+ * gate the CLKIN source while idle and around rate family switches, so
+ * LOS is masked and not reported otherwise. The status latched while it
+ * was disarmed is dropped when it is armed again.
+ */
+static void _si5351_los_update(struct si5351_driver_data *drvdata)
+{
+	bool arm = false;
+	u8 reset, lol, src;
+
+	if (drvdata->variant != SI5351_VARIANT_C)
+		return;
+
+	if (clk_hw_is_prepared(&drvdata->clkin)) {
+		_si5351_plls_in_use(drvdata, &reset, &lol);
+		src = si5351_reg_read(drvdata, SI5351_PLL_INPUT_SOURCE);
+		arm = ((reset & SI5351_PLL_RESET_A) &&
+		       (src & SI5351_PLLA_SOURCE)) ||
+		      ((reset & SI5351_PLL_RESET_B) &&
+		       (src & SI5351_PLLB_SOURCE));
+	}
+
+	if (arm == drvdata->los_armed)
+		return;
+
+	if (arm)
+		si5351_reg_write(drvdata, SI5351_INTERRUPT_STATUS,
+				 (u8)~SI5351_STATUS_LOS);
+	WRITE_ONCE(drvdata->los_armed, arm);
+
+	/* a set bit masks the interrupt */
+	if (drvdata->irq)
+		si5351_set_bits(drvdata, SI5351_INTERRUPT_MASK,
+				SI5351_STATUS_LOS, arm ? 0 : SI5351_STATUS_LOS);
+}
+
 static bool si5351_regmap_is_volatile(struct device *dev, unsigned int reg)
 {
 	switch (reg) {
@@ -203,11 +359,21 @@ static bool si5351_regmap_is_writeable(struct device *dev, unsigned int reg)
 	return true;
 }
 
+/* register blocks accounted separately in debugfs i2c_stats */
+static const struct taudac_regmap_range si5351_i2c_ranges[] = {
+	{ "status",  0,   2 },
+	{ "ctrl",    3,  25 },
+	{ "pll",    26,  41 },
+	{ "msynth", 42,  92 },
+	{ "phase", 165, 170 },
+	{ "misc",  177, 187 },
+};
+
 static const struct regmap_config si5351_regmap_config = {
 	.reg_bits = 8,
 	.val_bits = 8,
 	.cache_type = REGCACHE_MAPLE,
-	.max_register = 187,
+	.max_register = SI5351_MAX_REGISTER,
 	.writeable_reg = si5351_regmap_is_writeable,
 	.volatile_reg = si5351_regmap_is_volatile,
 };
@@ -253,6 +419,9 @@ static void si5351_clkin_unprepare(struct clk_hw *hw)
 {
 	struct si5351_driver_data *drvdata =
 		container_of(hw, struct si5351_driver_data, clkin);
+
+	/* the source may be gated from now on */
+	_si5351_los_update(drvdata);
 	si5351_set_bits(drvdata, SI5351_FANOUT_ENABLE,
 			SI5351_CLKIN_ENABLE, 0);
 }
@@ -303,38 +472,6 @@ static const struct clk_ops si5351_clkin_ops = {
  * Si5351 vxco clock input (Si5351B only)
  */
 
-static int si5351_vxco_prepare(struct clk_hw *hw)
-{
-	struct si5351_hw_data *hwdata =
-		container_of(hw, struct si5351_hw_data, hw);
-
-	dev_warn(&hwdata->drvdata->client->dev, "VXCO currently unsupported\n");
-
-	return 0;
-}
-
-static void si5351_vxco_unprepare(struct clk_hw *hw)
-{
-}
-
-static unsigned long si5351_vxco_recalc_rate(struct clk_hw *hw,
-					     unsigned long parent_rate)
-{
-	return 0;
-}
-
-static int si5351_vxco_set_rate(struct clk_hw *hw, unsigned long rate,
-				unsigned long parent)
-{
-	return 0;
-}
-
-static const struct clk_ops si5351_vxco_ops = {
-	.prepare = si5351_vxco_prepare,
-	.unprepare = si5351_vxco_unprepare,
-	.recalc_rate = si5351_vxco_recalc_rate,
-	.set_rate = si5351_vxco_set_rate,
-};
 
 /*
  * Si5351 pll a/b
@@ -398,6 +535,7 @@ static int si5351_pll_set_parent(struct clk_hw *hw, u8 index)
 {
 	struct si5351_hw_data *hwdata =
 		container_of(hw, struct si5351_hw_data, hw);
+	int ret;
 
 	if (hwdata->drvdata->variant != SI5351_VARIANT_C &&
 	    index > 0)
@@ -406,9 +544,12 @@ static int si5351_pll_set_parent(struct clk_hw *hw, u8 index)
 	if (index > 1)
 		return -EINVAL;
 
-	return _si5351_pll_reparent(hwdata->drvdata, hwdata->num,
+	ret = _si5351_pll_reparent(hwdata->drvdata, hwdata->num,
 			     (index == 0) ? SI5351_PLL_SRC_XTAL :
 			     SI5351_PLL_SRC_CLKIN);
+	_si5351_los_update(hwdata->drvdata);
+
+	return ret;
 }
 
 static unsigned long si5351_pll_recalc_rate(struct clk_hw *hw,
@@ -418,28 +559,30 @@ static unsigned long si5351_pll_recalc_rate(struct clk_hw *hw,
 		container_of(hw, struct si5351_hw_data, hw);
 	u8 reg = (hwdata->num == 0) ? SI5351_PLLA_PARAMETERS :
 		SI5351_PLLB_PARAMETERS;
-	unsigned long long rate;
+	unsigned long rate;
 
 	if (!hwdata->params.valid)
 		si5351_read_parameters(hwdata->drvdata, reg, &hwdata->params);
 
-	if (hwdata->params.p3 == 0)
-		return parent_rate;
-
-	/* fVCO = fIN * (P1*P3 + 512*P3 + P2)/(128*P3) */
-	rate  = hwdata->params.p1 * hwdata->params.p3;
-	rate += 512 * hwdata->params.p3;
-	rate += hwdata->params.p2;
-	rate *= parent_rate;
-	do_div(rate, 128 * hwdata->params.p3);
+	rate = si5351_pll_rate(&hwdata->params, parent_rate);
 
 	dev_dbg(&hwdata->drvdata->client->dev,
 		"%s - %s: p1 = %lu, p2 = %lu, p3 = %lu, parent_rate = %lu, rate = %lu\n",
 		__func__, clk_hw_get_name(hw),
 		hwdata->params.p1, hwdata->params.p2, hwdata->params.p3,
-		parent_rate, (unsigned long)rate);
+		parent_rate, rate);
+
+	return rate;
+}
+
+/* the Si5351B VCXO needs PLLB in fractional mode, even with P2 = 0 */
+static bool si5351_pll_integer_mode(struct si5351_hw_data *pll,
+				    struct si5351_parameters *params)
+{
+	if (pll->drvdata->variant == SI5351_VARIANT_B && pll->num == 1)
+		return false;
 
-	return (unsigned long)rate;
+	return params->p2 == 0;
 }
 
 static int si5351_pll_determine_rate(struct clk_hw *hw,
@@ -447,57 +590,17 @@ static int si5351_pll_determine_rate(struct clk_hw *hw,
 {
 	struct si5351_hw_data *hwdata =
 		container_of(hw, struct si5351_hw_data, hw);
-	unsigned long rate = req->rate;
-	unsigned long rfrac, denom, a, b, c;
-	unsigned long long lltmp;
-
-	if (rate < SI5351_PLL_VCO_MIN)
-		rate = SI5351_PLL_VCO_MIN;
-	if (rate > SI5351_PLL_VCO_MAX)
-		rate = SI5351_PLL_VCO_MAX;
 
-	/* determine integer part of feedback equation */
-	a = rate / req->best_parent_rate;
-
-	if (a < SI5351_PLL_A_MIN)
-		rate = req->best_parent_rate * SI5351_PLL_A_MIN;
-	if (a > SI5351_PLL_A_MAX)
-		rate = req->best_parent_rate * SI5351_PLL_A_MAX;
-
-	/* find best approximation for b/c = fVCO mod fIN */
-	denom = 1000 * 1000;
-	lltmp = rate % (req->best_parent_rate);
-	lltmp *= denom;
-	do_div(lltmp, req->best_parent_rate);
-	rfrac = (unsigned long)lltmp;
-
-	b = 0;
-	c = 1;
-	if (rfrac)
-		rational_best_approximation(rfrac, denom,
-				    SI5351_PLL_B_MAX, SI5351_PLL_C_MAX, &b, &c);
-
-	/* calculate parameters */
-	hwdata->params.p3  = c;
-	hwdata->params.p2  = (128 * b) % c;
-	hwdata->params.p1  = 128 * a;
-	hwdata->params.p1 += (128 * b / c);
-	hwdata->params.p1 -= 512;
-
-	/* recalculate rate by fIN * (a + b/c) */
-	lltmp  = req->best_parent_rate;
-	lltmp *= b;
-	do_div(lltmp, c);
-
-	rate  = (unsigned long)lltmp;
-	rate += req->best_parent_rate * a;
+	hwdata->req_rate = req->rate;
+	req->rate = si5351_pll_calc(&hwdata->params, req->rate,
+				    req->best_parent_rate);
 
 	dev_dbg(&hwdata->drvdata->client->dev,
-		"%s - %s: a = %lu, b = %lu, c = %lu, parent_rate = %lu, rate = %lu\n",
-		__func__, clk_hw_get_name(hw), a, b, c,
-		req->best_parent_rate, rate);
+		"%s - %s: p1 = %lu, p2 = %lu, p3 = %lu, parent_rate = %lu, rate = %lu\n",
+		__func__, clk_hw_get_name(hw),
+		hwdata->params.p1, hwdata->params.p2, hwdata->params.p3,
+		req->best_parent_rate, req->rate);
 
-	req->rate = rate;
 	return 0;
 }
 
@@ -511,19 +614,35 @@ static int si5351_pll_set_rate(struct clk_hw *hw, unsigned long rate,
 	u8 reg = (hwdata->num == 0) ? SI5351_PLLA_PARAMETERS :
 		SI5351_PLLB_PARAMETERS;
 
-	/* write multisynth parameters */
+	mutex_lock(&hwdata->drvdata->phase_lock);
+
+	/* write multisynth parameters, a new rate drops any trim */
+	mutex_lock(&hwdata->drvdata->trim_lock);
 	si5351_write_parameters(hwdata->drvdata, reg, &hwdata->params);
+	hwdata->drvdata->pll_nominal[hwdata->num] = hwdata->params;
+	hwdata->drvdata->pll_trim[hwdata->num] = 0;
+	mutex_unlock(&hwdata->drvdata->trim_lock);
 
 	/* plla/pllb ctrl is in clk6/clk7 ctrl registers */
 	si5351_set_bits(hwdata->drvdata, SI5351_CLK6_CTRL + hwdata->num,
 		SI5351_CLK_INTEGER_MODE,
-		(hwdata->params.p2 == 0) ? SI5351_CLK_INTEGER_MODE : 0);
+		si5351_pll_integer_mode(hwdata, &hwdata->params) ?
+		SI5351_CLK_INTEGER_MODE : 0);
 
 	/* Do a pll soft reset on the affected pll */
-	if (pdata->pll_reset[hwdata->num])
-		si5351_reg_write(hwdata->drvdata, SI5351_PLL_RESET,
-				 hwdata->num == 0 ? SI5351_PLL_RESET_A :
-						    SI5351_PLL_RESET_B);
+	if (pdata->pll_reset[hwdata->num]) {
+		u8 mask = hwdata->num == 0 ? SI5351_PLL_RESET_A :
+					     SI5351_PLL_RESET_B;
+
+		if (hwdata->drvdata->defer_pll_reset) {
+			hwdata->drvdata->pll_reset_pending |= mask;
+		} else {
+			_si5351_pll_reset(hwdata->drvdata, mask);
+			_si5351_pll_settle(hwdata->drvdata, mask);
+		}
+	}
+
+	mutex_unlock(&hwdata->drvdata->phase_lock);
 
 	dev_dbg(&hwdata->drvdata->client->dev,
 		"%s - %s: p1 = %lu, p2 = %lu, p3 = %lu, parent_rate = %lu, rate = %lu\n",
@@ -542,6 +661,113 @@ static const struct clk_ops si5351_pll_ops = {
 	.set_rate = si5351_pll_set_rate,
 };
 
+/*
+ * Si5351 vxco clock input (Si5351B only)
+ *
+ * PLLB is pulled by the voltage on the VC pin. It runs off the xtal with
+ * a fixed feedback denominator of 10^6, and the VCXO parameter scales the
+ * pull to the absolute pull range (APR) of the board:
+ *
+ *   VCXO_Param = 1.03 * (128 * a + b / 10^6) * APR
+ */
+static void si5351_vxco_write_param(struct si5351_hw_data *hwdata)
+{
+	struct si5351_driver_data *drvdata = hwdata->drvdata;
+	struct si5351_parameters *p = &hwdata->params;
+	u64 x, a, b, param;
+	u8 buf[3];
+
+	if (!p->p3)
+		return;
+
+	/*
+	 * X = (P1 + 512) * P3 + P2 = 128 * (a * c + b) with c = P3, so
+	 * a = X / (128 * c), and b is the remainder scaled to 10^6.
+	 */
+	x = (u64)(p->p1 + 512) * p->p3 + p->p2;
+	a = div_u64(x, 128 * p->p3);
+	b = div_u64((x - a * 128 * p->p3) * SI5351_VXCO_DENOM, 128 * p->p3);
+
+	/* (128 * a + b / 10^6) * 10^6 */
+	param = 128 * a * SI5351_VXCO_DENOM + b;
+	param = div_u64(param * drvdata->vcxo_apr * 103,
+			100 * SI5351_VXCO_DENOM);
+	param = min_t(u64, param, SI5351_VXCO_PARAM_MAX);
+
+	buf[0] = param & 0xff;
+	buf[1] = (param >> 8) & 0xff;
+	buf[2] = (param >> 16) & 0x3f;
+	si5351_bulk_write(drvdata, SI5351_VXCO_PARAMETERS_LOW, 3, buf);
+}
+
+static int si5351_vxco_determine_rate(struct clk_hw *hw,
+				      struct clk_rate_request *req)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+	unsigned long rate = req->rate;
+	unsigned long a, b;
+	unsigned long long lltmp;
+
+	hwdata->req_rate = req->rate;
+	rate = clamp_t(unsigned long, rate, SI5351_PLL_VCO_MIN,
+		       SI5351_PLL_VCO_MAX);
+
+	a = rate / req->best_parent_rate;
+	if (a < SI5351_PLL_A_MIN) {
+		a = SI5351_PLL_A_MIN;
+		rate = req->best_parent_rate * a;
+	}
+	if (a >= SI5351_PLL_A_MAX) {
+		a = SI5351_PLL_A_MAX;
+		rate = req->best_parent_rate * a;
+	}
+
+	/* b/c = fVCO mod fIN with fixed c = 10^6 */
+	lltmp = rate % req->best_parent_rate;
+	lltmp *= SI5351_VXCO_DENOM;
+	lltmp = DIV_ROUND_CLOSEST_ULL(lltmp, req->best_parent_rate);
+	b = (unsigned long)lltmp;
+
+	si5351_params_encode(&hwdata->params, a, b, SI5351_VXCO_DENOM);
+
+	lltmp  = req->best_parent_rate;
+	lltmp *= b;
+	do_div(lltmp, SI5351_VXCO_DENOM);
+
+	req->rate = (unsigned long)lltmp + req->best_parent_rate * a;
+
+	dev_dbg(&hwdata->drvdata->client->dev,
+		"%s - %s: a = %lu, b = %lu, parent_rate = %lu, rate = %lu\n",
+		__func__, clk_hw_get_name(hw), a, b,
+		req->best_parent_rate, req->rate);
+
+	return 0;
+}
+
+static int si5351_vxco_set_rate(struct clk_hw *hw, unsigned long rate,
+				unsigned long parent_rate)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+	int ret;
+
+	/* keeps PLLB in fractional mode, see si5351_pll_integer_mode() */
+	ret = si5351_pll_set_rate(hw, rate, parent_rate);
+	if (ret)
+		return ret;
+
+	si5351_vxco_write_param(hwdata);
+
+	return 0;
+}
+
+static const struct clk_ops si5351_vxco_ops = {
+	.recalc_rate = si5351_pll_recalc_rate,
+	.determine_rate = si5351_vxco_determine_rate,
+	.set_rate = si5351_vxco_set_rate,
+};
+
 /*
  * Si5351 multisync divider
  *
@@ -607,42 +833,25 @@ static unsigned long si5351_msynth_recalc_rate(struct clk_hw *hw,
 	struct si5351_hw_data *hwdata =
 		container_of(hw, struct si5351_hw_data, hw);
 	u8 reg = si5351_msynth_params_address(hwdata->num);
-	unsigned long long rate;
-	unsigned long m;
+	unsigned long rate;
+	bool divby4;
 
 	if (!hwdata->params.valid)
 		si5351_read_parameters(hwdata->drvdata, reg, &hwdata->params);
 
-	/*
-	 * multisync0-5: fOUT = (128 * P3 * fIN) / (P1*P3 + P2 + 512*P3)
-	 * multisync6-7: fOUT = fIN / P1
-	 */
-	rate = parent_rate;
-	if (hwdata->num > 5) {
-		m = hwdata->params.p1;
-	} else if (hwdata->params.p3 == 0) {
-		return parent_rate;
-	} else if ((si5351_reg_read(hwdata->drvdata, reg + 2) &
-		    SI5351_OUTPUT_CLK_DIVBY4) == SI5351_OUTPUT_CLK_DIVBY4) {
-		m = 4;
-	} else {
-		rate *= 128 * hwdata->params.p3;
-		m = hwdata->params.p1 * hwdata->params.p3;
-		m += hwdata->params.p2;
-		m += 512 * hwdata->params.p3;
-	}
-
-	if (m == 0)
-		return 0;
-	do_div(rate, m);
+	divby4 = hwdata->num <= 5 && hwdata->params.p3 &&
+		 (si5351_reg_read(hwdata->drvdata, reg + 2) &
+		  SI5351_OUTPUT_CLK_DIVBY4) == SI5351_OUTPUT_CLK_DIVBY4;
+	rate = si5351_msynth_rate(&hwdata->params, hwdata->num, divby4,
+				  parent_rate);
 
 	dev_dbg(&hwdata->drvdata->client->dev,
-		"%s - %s: p1 = %lu, p2 = %lu, p3 = %lu, m = %lu, parent_rate = %lu, rate = %lu\n",
+		"%s - %s: p1 = %lu, p2 = %lu, p3 = %lu, divby4 = %d, parent_rate = %lu, rate = %lu\n",
 		__func__, clk_hw_get_name(hw),
 		hwdata->params.p1, hwdata->params.p2, hwdata->params.p3,
-		m, parent_rate, (unsigned long)rate);
+		divby4, parent_rate, rate);
 
-	return (unsigned long)rate;
+	return rate;
 }
 
 static int si5351_msynth_determine_rate(struct clk_hw *hw,
@@ -650,112 +859,18 @@ static int si5351_msynth_determine_rate(struct clk_hw *hw,
 {
 	struct si5351_hw_data *hwdata =
 		container_of(hw, struct si5351_hw_data, hw);
-	unsigned long rate = req->rate;
-	unsigned long long lltmp;
-	unsigned long a, b, c;
 	int divby4;
 
-	/* multisync6-7 can only handle freqencies < 150MHz */
-	if (hwdata->num >= 6 && rate > SI5351_MULTISYNTH67_MAX_FREQ)
-		rate = SI5351_MULTISYNTH67_MAX_FREQ;
-
-	/* multisync frequency is 1MHz .. 160MHz */
-	if (rate > SI5351_MULTISYNTH_MAX_FREQ)
-		rate = SI5351_MULTISYNTH_MAX_FREQ;
-	if (rate < SI5351_MULTISYNTH_MIN_FREQ)
-		rate = SI5351_MULTISYNTH_MIN_FREQ;
-
-	divby4 = 0;
-	if (rate > SI5351_MULTISYNTH_DIVBY4_FREQ)
-		divby4 = 1;
-
-	/* multisync can set pll */
-	if (clk_hw_get_flags(hw) & CLK_SET_RATE_PARENT) {
-		/*
-		 * find largest integer divider for max
-		 * vco frequency and given target rate
-		 */
-		if (divby4 == 0) {
-			lltmp = SI5351_PLL_VCO_MAX;
-			do_div(lltmp, rate);
-			a = (unsigned long)lltmp;
-		} else
-			a = 4;
-
-		b = 0;
-		c = 1;
-
-		req->best_parent_rate = a * rate;
-	} else if (hwdata->num >= 6) {
-		/* determine the closest integer divider */
-		a = DIV_ROUND_CLOSEST(req->best_parent_rate, rate);
-		if (a < SI5351_MULTISYNTH_A_MIN)
-			a = SI5351_MULTISYNTH_A_MIN;
-		if (a > SI5351_MULTISYNTH67_A_MAX)
-			a = SI5351_MULTISYNTH67_A_MAX;
-
-		b = 0;
-		c = 1;
-	} else {
-		unsigned long rfrac, denom;
-
-		/* disable divby4 */
-		if (divby4) {
-			rate = SI5351_MULTISYNTH_DIVBY4_FREQ;
-			divby4 = 0;
-		}
-
-		/* determine integer part of divider equation */
-		a = req->best_parent_rate / rate;
-		if (a < SI5351_MULTISYNTH_A_MIN)
-			a = SI5351_MULTISYNTH_A_MIN;
-		if (a > SI5351_MULTISYNTH_A_MAX)
-			a = SI5351_MULTISYNTH_A_MAX;
-
-		/* find best approximation for b/c = fVCO mod fOUT */
-		denom = 1000 * 1000;
-		lltmp = req->best_parent_rate % rate;
-		lltmp *= denom;
-		do_div(lltmp, rate);
-		rfrac = (unsigned long)lltmp;
-
-		b = 0;
-		c = 1;
-		if (rfrac)
-			rational_best_approximation(rfrac, denom,
-			    SI5351_MULTISYNTH_B_MAX, SI5351_MULTISYNTH_C_MAX,
-			    &b, &c);
-	}
-
-	/* recalculate rate by fOUT = fIN / (a + b/c) */
-	lltmp  = req->best_parent_rate;
-	lltmp *= c;
-	do_div(lltmp, a * c + b);
-	rate  = (unsigned long)lltmp;
-
-	/* calculate parameters */
-	if (divby4) {
-		hwdata->params.p3 = 1;
-		hwdata->params.p2 = 0;
-		hwdata->params.p1 = 0;
-	} else if (hwdata->num >= 6) {
-		hwdata->params.p3 = 0;
-		hwdata->params.p2 = 0;
-		hwdata->params.p1 = a;
-	} else {
-		hwdata->params.p3  = c;
-		hwdata->params.p2  = (128 * b) % c;
-		hwdata->params.p1  = 128 * a;
-		hwdata->params.p1 += (128 * b / c);
-		hwdata->params.p1 -= 512;
-	}
+	hwdata->req_rate = req->rate;
+	req->rate = si5351_msynth_calc(&hwdata->params, &divby4, hwdata->num,
+			req->rate, &req->best_parent_rate,
+			clk_hw_get_flags(hw) & CLK_SET_RATE_PARENT);
 
 	dev_dbg(&hwdata->drvdata->client->dev,
-		"%s - %s: a = %lu, b = %lu, c = %lu, divby4 = %d, parent_rate = %lu, rate = %lu\n",
-		__func__, clk_hw_get_name(hw), a, b, c, divby4,
-		req->best_parent_rate, rate);
-
-	req->rate = rate;
+		"%s - %s: p1 = %lu, p2 = %lu, p3 = %lu, divby4 = %d, parent_rate = %lu, rate = %lu\n",
+		__func__, clk_hw_get_name(hw),
+		hwdata->params.p1, hwdata->params.p2, hwdata->params.p3,
+		divby4, req->best_parent_rate, req->rate);
 
 	return 0;
 }
@@ -768,12 +883,28 @@ static int si5351_msynth_set_rate(struct clk_hw *hw, unsigned long rate,
 	u8 reg = si5351_msynth_params_address(hwdata->num);
 	int divby4 = 0;
 
-	/* write multisynth parameters */
-	si5351_write_parameters(hwdata->drvdata, reg, &hwdata->params);
-
 	if (rate > SI5351_MULTISYNTH_DIVBY4_FREQ)
 		divby4 = 1;
 
+	/*
+	 * The clk framework calls set_rate on the child right after, so
+	 * let the output write the parameters together with its R divider.
+	 */
+	if (hwdata->num < 6 &&
+	    clk_hw_get_parent(&hwdata->drvdata->clkout[hwdata->num].hw) == hw) {
+		hwdata->params_pending = true;
+		hwdata->divby4 = divby4;
+		dev_dbg(&hwdata->drvdata->client->dev,
+			"%s - %s: p1 = %lu, p2 = %lu, p3 = %lu, divby4 = %d, parent_rate = %lu, rate = %lu (deferred)\n",
+			__func__, clk_hw_get_name(hw),
+			hwdata->params.p1, hwdata->params.p2,
+			hwdata->params.p3, divby4, parent_rate, rate);
+		return 0;
+	}
+
+	/* write multisynth parameters */
+	si5351_write_parameters(hwdata->drvdata, reg, &hwdata->params);
+
 	/* enable/disable integer mode and divby4 on multisynth0-5 */
 	if (hwdata->num < 6) {
 		si5351_set_bits(hwdata->drvdata, reg + 2,
@@ -913,6 +1044,7 @@ static void _si5351_clkout_reset_pll(struct si5351_driver_data *drvdata, int num
 	u8 mask = val & SI5351_CLK_PLL_SELECT ? SI5351_PLL_RESET_B :
 						       SI5351_PLL_RESET_A;
 	unsigned int v;
+	u64 t;
 	int err;
 
 	switch (val & SI5351_CLK_INPUT_MASK) {
@@ -921,73 +1053,280 @@ static void _si5351_clkout_reset_pll(struct si5351_driver_data *drvdata, int num
 		return;  /* pll not used, no need to reset */
 	}
 
-	si5351_reg_write(drvdata, SI5351_PLL_RESET, mask);
+	t = ktime_get_ns();
+	_si5351_pll_reset(drvdata, mask);
 
 	err = regmap_read_poll_timeout(drvdata->regmap, SI5351_PLL_RESET, v,
 				 !(v & mask), 0, 20000);
 	if (err < 0)
 		dev_err(&drvdata->client->dev, "Reset bit didn't clear\n");
+	else
+		_si5351_pll_settle(drvdata, mask);
+	trace_si5351_pll_reset(&drvdata->client->dev, mask,
+			       ktime_get_ns() - t, err);
 
 	dev_dbg(&drvdata->client->dev, "%s - %s: pll = %d\n",
 		__func__, clk_hw_get_name(&drvdata->clkout[num].hw),
 		(val & SI5351_CLK_PLL_SELECT) ? 1 : 0);
 }
 
-static int si5351_clkout_prepare(struct clk_hw *hw)
+/*
+ * Outputs routed through the OEB pin are switched together: the pin is
+ * asserted with the first of them and released with the last one. The
+ * pin is driven from enable/disable if the GPIO does not sleep, else
+ * from prepare/unprepare.
+ *
+ * The output enable bits are written one by one from prepare, so with a
+ * sleeping GPIO the outputs prepared after the first one would start on
+ * their own I2C write. Consumers needing all outputs to start on one edge
+ * hold the pin with si5351_clk_oeb_hold() while they prepare and enable
+ * them, and release it once all are running.
+ */
+static inline bool si5351_clkout_oeb_controlled(struct si5351_hw_data *hwdata)
 {
-	struct si5351_hw_data *hwdata =
-		container_of(hw, struct si5351_hw_data, hw);
-	struct si5351_platform_data *pdata =
-		hwdata->drvdata->client->dev.platform_data;
+	return hwdata->drvdata->oeb_mask & (1 << hwdata->num);
+}
 
-	si5351_set_bits(hwdata->drvdata, SI5351_CLK0_CTRL + hwdata->num,
-			SI5351_CLK_POWERDOWN, 0);
+static unsigned long si5351_oeb_lock(struct si5351_driver_data *drvdata)
+{
+	unsigned long flags = 0;
 
-	/*
-	 * Do a pll soft reset on the parent pll -- needed to get a
-	 * deterministic phase relationship between the output clocks.
-	 */
-	if (pdata->clkout[hwdata->num].pll_reset)
-		_si5351_clkout_reset_pll(hwdata->drvdata, hwdata->num);
+	if (gpiod_cansleep(drvdata->oeb_gpio))
+		mutex_lock(&drvdata->oeb_mutex);
+	else
+		spin_lock_irqsave(&drvdata->oeb_spinlock, flags);
 
-	si5351_set_bits(hwdata->drvdata, SI5351_OUTPUT_ENABLE_CTRL,
-			(1 << hwdata->num), 0);
+	return flags;
+}
 
-	/*
-	 * Do one more pll reset after enabling the clocks -- this is
-	 * a workaround recommended by the Silicon Labs support team
-	 * to avoid (sporadic) random phase offsets between the output
-	 * clocks.
-	 */
-	if (pdata->clkout[hwdata->num].pll_reset)
-		_si5351_clkout_reset_pll(hwdata->drvdata, hwdata->num);
+static void si5351_oeb_unlock(struct si5351_driver_data *drvdata,
+			      unsigned long flags)
+{
+	if (gpiod_cansleep(drvdata->oeb_gpio))
+		mutex_unlock(&drvdata->oeb_mutex);
+	else
+		spin_unlock_irqrestore(&drvdata->oeb_spinlock, flags);
+}
 
-	return 0;
+static void _si5351_oeb_update(struct si5351_driver_data *drvdata)
+{
+	bool on = drvdata->oeb_count > 0 && !drvdata->oeb_hold;
+
+	if (on == drvdata->oeb_on)
+		return;
+
+	drvdata->oeb_on = on;
+	if (gpiod_cansleep(drvdata->oeb_gpio))
+		gpiod_set_value_cansleep(drvdata->oeb_gpio, on);
+	else
+		gpiod_set_value(drvdata->oeb_gpio, on);
 }
 
-static void si5351_clkout_unprepare(struct clk_hw *hw)
+static void _si5351_clkout_oeb_get(struct si5351_driver_data *drvdata)
 {
-	struct si5351_hw_data *hwdata =
-		container_of(hw, struct si5351_hw_data, hw);
+	unsigned long flags = si5351_oeb_lock(drvdata);
 
-	si5351_set_bits(hwdata->drvdata, SI5351_CLK0_CTRL + hwdata->num,
-			SI5351_CLK_POWERDOWN, SI5351_CLK_POWERDOWN);
-	si5351_set_bits(hwdata->drvdata, SI5351_OUTPUT_ENABLE_CTRL,
-			(1 << hwdata->num), (1 << hwdata->num));
+	drvdata->oeb_count++;
+	_si5351_oeb_update(drvdata);
+	si5351_oeb_unlock(drvdata, flags);
 }
 
-static u8 si5351_clkout_get_parent(struct clk_hw *hw)
+static void _si5351_clkout_oeb_put(struct si5351_driver_data *drvdata)
 {
-	struct si5351_hw_data *hwdata =
-		container_of(hw, struct si5351_hw_data, hw);
-	int index = 0;
-	unsigned char val;
+	unsigned long flags = si5351_oeb_lock(drvdata);
 
-	val = si5351_reg_read(hwdata->drvdata, SI5351_CLK0_CTRL + hwdata->num);
-	switch (val & SI5351_CLK_INPUT_MASK) {
-	case SI5351_CLK_INPUT_MULTISYNTH_N:
-		index = 0;
-		break;
+	if (!WARN_ON(drvdata->oeb_count == 0))
+		drvdata->oeb_count--;
+	_si5351_oeb_update(drvdata);
+	si5351_oeb_unlock(drvdata, flags);
+}
+
+/*
+ * Outputs 0..5 can be delayed against the other outputs of the same PLL
+ * in steps of a quarter VCO period, up to 127 steps. The offset is only
+ * picked up on a PLL reset, so it is kept in ps and converted for the
+ * VCO rate in use when the output is prepared.
+ */
+static unsigned long si5351_clkout_vco_rate(struct si5351_hw_data *hwdata)
+{
+	struct clk_hw *ms = clk_hw_get_parent(&hwdata->hw);
+	struct clk_hw *pll = ms ? clk_hw_get_parent(ms) : NULL;
+	int n;
+
+	/* only outputs fed from a multisynth have a phase offset */
+	for (n = 0; n < 2; n++)
+		if (pll && pll == &hwdata->drvdata->pll[n].hw)
+			return clk_hw_get_rate(pll);
+
+	return 0;
+}
+
+static void _si5351_clkout_write_phase(struct si5351_hw_data *hwdata)
+{
+	unsigned long vco = si5351_clkout_vco_rate(hwdata);
+	u64 phoff;
+
+	if (!vco)
+		return;
+
+	phoff = (u64)hwdata->drvdata->phase_ps[hwdata->num] * 4 * vco;
+	phoff = div64_u64(phoff + PSEC_PER_SEC / 2, PSEC_PER_SEC);
+	phoff = min_t(u64, phoff, SI5351_CLK_PHOFF_MAX);
+
+	si5351_reg_write(hwdata->drvdata,
+			 SI5351_CLK0_PHASE_OFFSET + hwdata->num, phoff);
+}
+
+static int _si5351_clkout_set_phase_ps(struct si5351_hw_data *hwdata,
+				       u32 ps)
+{
+	struct si5351_driver_data *drvdata = hwdata->drvdata;
+	u8 val;
+
+	if (hwdata->num > 5 || !si5351_clkout_vco_rate(hwdata))
+		return -EINVAL;
+
+	mutex_lock(&drvdata->phase_lock);
+	drvdata->phase_ps[hwdata->num] = ps;
+
+	/* a running output needs a PLL reset to pick it up */
+	val = si5351_reg_read(drvdata, SI5351_CLK0_CTRL + hwdata->num);
+	if (!(val & SI5351_CLK_POWERDOWN)) {
+		_si5351_clkout_write_phase(hwdata);
+		_si5351_clkout_reset_pll(drvdata, hwdata->num);
+	}
+	mutex_unlock(&drvdata->phase_lock);
+
+	return 0;
+}
+
+static int si5351_clkout_get_phase(struct clk_hw *hw)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+	unsigned long vco = si5351_clkout_vco_rate(hwdata);
+	u64 deg;
+
+	if (hwdata->num > 5 || !vco)
+		return 0;
+
+	/* degrees = phoff * (Tvco / 4) / Tout * 360 */
+	deg = si5351_reg_read(hwdata->drvdata,
+			      SI5351_CLK0_PHASE_OFFSET + hwdata->num) &
+	      SI5351_CLK_PHOFF_MAX;
+	deg *= 360ULL * clk_hw_get_rate(hw);
+
+	return div64_u64(deg + 2 * vco, 4ULL * vco) % 360;
+}
+
+static int si5351_clkout_set_phase(struct clk_hw *hw, int degrees)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+	unsigned long rate = clk_hw_get_rate(hw);
+
+	if (!rate)
+		return -EINVAL;
+
+	return _si5351_clkout_set_phase_ps(hwdata,
+			div64_u64((u64)degrees * PSEC_PER_SEC, 360ULL * rate));
+}
+
+static int si5351_clkout_prepare(struct clk_hw *hw)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+	struct si5351_platform_data *pdata =
+		hwdata->drvdata->client->dev.platform_data;
+
+	si5351_set_bits(hwdata->drvdata, SI5351_CLK0_CTRL + hwdata->num,
+			SI5351_CLK_POWERDOWN, 0);
+
+	mutex_lock(&hwdata->drvdata->phase_lock);
+	if (hwdata->num <= 5)
+		_si5351_clkout_write_phase(hwdata);
+
+	/*
+	 * Do a pll soft reset on the parent pll -- needed to get a
+	 * deterministic phase relationship between the output clocks.
+	 */
+	if (pdata->clkout[hwdata->num].pll_reset)
+		_si5351_clkout_reset_pll(hwdata->drvdata, hwdata->num);
+
+	si5351_set_bits(hwdata->drvdata, SI5351_OUTPUT_ENABLE_CTRL,
+			(1 << hwdata->num), 0);
+
+	/*
+	 * Do one more pll reset after enabling the clocks -- this is
+	 * a workaround recommended by the Silicon Labs support team
+	 * to avoid (sporadic) random phase offsets between the output
+	 * clocks. The programmable phase offsets rely on the same
+	 * alignment, so they do not make it redundant.
+	 */
+	if (pdata->clkout[hwdata->num].pll_reset)
+		_si5351_clkout_reset_pll(hwdata->drvdata, hwdata->num);
+	mutex_unlock(&hwdata->drvdata->phase_lock);
+
+	if (si5351_clkout_oeb_controlled(hwdata) &&
+	    gpiod_cansleep(hwdata->drvdata->oeb_gpio))
+		_si5351_clkout_oeb_get(hwdata->drvdata);
+
+	_si5351_los_update(hwdata->drvdata);
+
+	return 0;
+}
+
+static void si5351_clkout_unprepare(struct clk_hw *hw)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+
+	if (si5351_clkout_oeb_controlled(hwdata) &&
+	    gpiod_cansleep(hwdata->drvdata->oeb_gpio))
+		_si5351_clkout_oeb_put(hwdata->drvdata);
+
+	si5351_set_bits(hwdata->drvdata, SI5351_CLK0_CTRL + hwdata->num,
+			SI5351_CLK_POWERDOWN, SI5351_CLK_POWERDOWN);
+	si5351_set_bits(hwdata->drvdata, SI5351_OUTPUT_ENABLE_CTRL,
+			(1 << hwdata->num), (1 << hwdata->num));
+
+	_si5351_los_update(hwdata->drvdata);
+}
+
+static int si5351_clkout_enable(struct clk_hw *hw)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+
+	if (si5351_clkout_oeb_controlled(hwdata) &&
+	    !gpiod_cansleep(hwdata->drvdata->oeb_gpio))
+		_si5351_clkout_oeb_get(hwdata->drvdata);
+
+	return 0;
+}
+
+static void si5351_clkout_disable(struct clk_hw *hw)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+
+	if (si5351_clkout_oeb_controlled(hwdata) &&
+	    !gpiod_cansleep(hwdata->drvdata->oeb_gpio))
+		_si5351_clkout_oeb_put(hwdata->drvdata);
+}
+
+static u8 si5351_clkout_get_parent(struct clk_hw *hw)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+	int index = 0;
+	unsigned char val;
+
+	val = si5351_reg_read(hwdata->drvdata, SI5351_CLK0_CTRL + hwdata->num);
+	switch (val & SI5351_CLK_INPUT_MASK) {
+	case SI5351_CLK_INPUT_MULTISYNTH_N:
+		index = 0;
+		break;
 	case SI5351_CLK_INPUT_MULTISYNTH_0_4:
 		index = 1;
 		break;
@@ -999,173 +1338,1316 @@ static u8 si5351_clkout_get_parent(struct clk_hw *hw)
 		break;
 	}
 
-	return index;
+	return index;
+}
+
+static int si5351_clkout_set_parent(struct clk_hw *hw, u8 index)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+	enum si5351_clkout_src parent = SI5351_CLKOUT_SRC_DEFAULT;
+
+	switch (index) {
+	case 0:
+		parent = SI5351_CLKOUT_SRC_MSYNTH_N;
+		break;
+	case 1:
+		parent = SI5351_CLKOUT_SRC_MSYNTH_0_4;
+		break;
+	case 2:
+		parent = SI5351_CLKOUT_SRC_XTAL;
+		break;
+	case 3:
+		parent = SI5351_CLKOUT_SRC_CLKIN;
+		break;
+	}
+
+	return _si5351_clkout_reparent(hwdata->drvdata, hwdata->num, parent);
+}
+
+static unsigned long si5351_clkout_recalc_rate(struct clk_hw *hw,
+					       unsigned long parent_rate)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+	unsigned char reg;
+	unsigned char rdiv;
+
+	if (hwdata->num <= 5)
+		reg = si5351_msynth_params_address(hwdata->num) + 2;
+	else
+		reg = SI5351_CLK6_7_OUTPUT_DIVIDER;
+
+	rdiv = si5351_reg_read(hwdata->drvdata, reg);
+	if (hwdata->num == 6) {
+		rdiv &= SI5351_OUTPUT_CLK6_DIV_MASK;
+	} else {
+		rdiv &= SI5351_OUTPUT_CLK_DIV_MASK;
+		rdiv >>= SI5351_OUTPUT_CLK_DIV_SHIFT;
+	}
+
+	return parent_rate >> rdiv;
+}
+
+static int si5351_clkout_determine_rate(struct clk_hw *hw,
+					struct clk_rate_request *req)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+	unsigned long rate = req->rate;
+	unsigned char rdiv;
+
+	hwdata->req_rate = req->rate;
+	/* clkout6/7 can only handle output freqencies < 150MHz */
+	if (hwdata->num >= 6 && rate > SI5351_CLKOUT67_MAX_FREQ)
+		rate = SI5351_CLKOUT67_MAX_FREQ;
+
+	/* clkout freqency is 8kHz - 160MHz */
+	if (rate > SI5351_CLKOUT_MAX_FREQ)
+		rate = SI5351_CLKOUT_MAX_FREQ;
+	if (rate < SI5351_CLKOUT_MIN_FREQ)
+		rate = SI5351_CLKOUT_MIN_FREQ;
+
+	/* request frequency if multisync master */
+	if (clk_hw_get_flags(hw) & CLK_SET_RATE_PARENT) {
+		/* use r divider for frequencies below 1MHz */
+		rdiv = si5351_rdiv_raise(&rate);
+		req->best_parent_rate = rate;
+	} else {
+		rdiv = si5351_rdiv_closest(rate, req->best_parent_rate);
+	}
+	rate = req->best_parent_rate >> rdiv;
+
+	dev_dbg(&hwdata->drvdata->client->dev,
+		"%s - %s: rdiv = %u, parent_rate = %lu, rate = %lu\n",
+		__func__, clk_hw_get_name(hw), (1 << rdiv),
+		req->best_parent_rate, rate);
+
+	req->rate = rate;
+	return 0;
+}
+
+/*
+ * Write pending multisynth parameters, divby4 and the R divider in a
+ * single burst. A running output is held in its disable state around
+ * the burst, and the integer mode bit is switched while it is held, so
+ * no intermediate frequency makes it to the pin.
+ */
+static void _si5351_clkout_retune(struct si5351_hw_data *hwdata,
+				  unsigned char rdiv)
+{
+	struct si5351_driver_data *drvdata = hwdata->drvdata;
+	struct si5351_hw_data *ms = &drvdata->msynth[hwdata->num];
+	struct si5351_parameters *params = &ms->params;
+	u8 reg = si5351_msynth_params_address(hwdata->num);
+	u8 ctrl = SI5351_CLK0_CTRL + hwdata->num;
+	u8 mask = 1 << hwdata->num;
+	u8 buf[SI5351_PARAMETERS_LENGTH];
+	bool running;
+
+	running = !(si5351_reg_read(drvdata, ctrl) & SI5351_CLK_POWERDOWN) &&
+		  !(si5351_reg_read(drvdata, SI5351_OUTPUT_ENABLE_CTRL) & mask);
+	if (running)
+		si5351_set_bits(drvdata, SI5351_OUTPUT_ENABLE_CTRL, mask, mask);
+
+	if (params->p2)
+		si5351_set_bits(drvdata, ctrl, SI5351_CLK_INTEGER_MODE, 0);
+
+	si5351_params_pack(params, buf);
+	buf[2] |= (rdiv << SI5351_OUTPUT_CLK_DIV_SHIFT) &
+		  SI5351_OUTPUT_CLK_DIV_MASK;
+	buf[2] |= ms->divby4 ? SI5351_OUTPUT_CLK_DIVBY4 : 0;
+	si5351_bulk_write(drvdata, reg, SI5351_PARAMETERS_LENGTH, buf);
+
+	if (!params->p2)
+		si5351_set_bits(drvdata, ctrl, SI5351_CLK_INTEGER_MODE,
+				SI5351_CLK_INTEGER_MODE);
+
+	if (running)
+		si5351_set_bits(drvdata, SI5351_OUTPUT_ENABLE_CTRL, mask, 0);
+
+	ms->params_pending = false;
+}
+
+static int si5351_clkout_set_rate(struct clk_hw *hw, unsigned long rate,
+				  unsigned long parent_rate)
+{
+	struct si5351_hw_data *hwdata =
+		container_of(hw, struct si5351_hw_data, hw);
+	unsigned char rdiv = si5351_rdiv_closest(rate, parent_rate);
+
+	/* write output divider */
+	mutex_lock(&hwdata->drvdata->phase_lock);
+	switch (hwdata->num) {
+	case 6:
+		si5351_set_bits(hwdata->drvdata, SI5351_CLK6_7_OUTPUT_DIVIDER,
+				SI5351_OUTPUT_CLK6_DIV_MASK, rdiv);
+		break;
+	case 7:
+		si5351_set_bits(hwdata->drvdata, SI5351_CLK6_7_OUTPUT_DIVIDER,
+				SI5351_OUTPUT_CLK_DIV_MASK,
+				rdiv << SI5351_OUTPUT_CLK_DIV_SHIFT);
+		break;
+	default:
+		if (hwdata->drvdata->msynth[hwdata->num].params_pending &&
+		    clk_hw_get_parent(hw) ==
+		    &hwdata->drvdata->msynth[hwdata->num].hw) {
+			_si5351_clkout_retune(hwdata, rdiv);
+			break;
+		}
+		si5351_set_bits(hwdata->drvdata,
+				si5351_msynth_params_address(hwdata->num) + 2,
+				SI5351_OUTPUT_CLK_DIV_MASK,
+				rdiv << SI5351_OUTPUT_CLK_DIV_SHIFT);
+	}
+	mutex_unlock(&hwdata->drvdata->phase_lock);
+
+	dev_dbg(&hwdata->drvdata->client->dev,
+		"%s - %s: rdiv = %u, parent_rate = %lu, rate = %lu\n",
+		__func__, clk_hw_get_name(hw), (1 << rdiv),
+		parent_rate, rate);
+
+	return 0;
+}
+
+static const struct clk_ops si5351_clkout_ops = {
+	.prepare = si5351_clkout_prepare,
+	.unprepare = si5351_clkout_unprepare,
+	.enable = si5351_clkout_enable,
+	.disable = si5351_clkout_disable,
+	.set_parent = si5351_clkout_set_parent,
+	.get_parent = si5351_clkout_get_parent,
+	.recalc_rate = si5351_clkout_recalc_rate,
+	.determine_rate = si5351_clkout_determine_rate,
+	.set_rate = si5351_clkout_set_rate,
+	.get_phase = si5351_clkout_get_phase,
+	.set_phase = si5351_clkout_set_phase,
+};
+
+/*
+ * Collect the PLLs feeding a powered up multisynth output, as reset
+ * and loss of lock status masks.
+ */
+static void _si5351_plls_in_use(struct si5351_driver_data *drvdata,
+				u8 *reset, u8 *lol)
+{
+	int n;
+	u8 val;
+
+	*reset = 0;
+	*lol = 0;
+
+	for (n = 0; n < drvdata->num_clkout; n++) {
+		val = si5351_reg_read(drvdata, SI5351_CLK0_CTRL + n);
+		if (val & SI5351_CLK_POWERDOWN)
+			continue;
+
+		switch (val & SI5351_CLK_INPUT_MASK) {
+		case SI5351_CLK_INPUT_XTAL:
+		case SI5351_CLK_INPUT_CLKIN:
+			continue;  /* pll not used */
+		}
+
+		if (val & SI5351_CLK_PLL_SELECT) {
+			*reset |= SI5351_PLL_RESET_B;
+			*lol |= SI5351_STATUS_LOL_B;
+		} else {
+			*reset |= SI5351_PLL_RESET_A;
+			*lol |= SI5351_STATUS_LOL_A;
+		}
+	}
+}
+
+/*
+ * After a power loss the PLLs have to be reset once the register image
+ * has been restored. Only the PLLs in use are reset and waited for.
+ */
+static int _si5351_pll_relock(struct si5351_driver_data *drvdata)
+{
+	u64 t;
+	u8 reset, lol;
+	int err;
+
+	_si5351_plls_in_use(drvdata, &reset, &lol);
+	if (!reset)
+		return 0;
+
+	t = ktime_get_ns();
+	_si5351_pll_reset(drvdata, reset);
+	err = _si5351_pll_settle(drvdata, reset);
+	trace_si5351_pll_reset(&drvdata->client->dev, reset,
+			       ktime_get_ns() - t, err);
+	if (err < 0)
+		dev_err(&drvdata->client->dev, "PLL did not lock\n");
+
+	return err;
+}
+
+/*
+ * Si5351 runtime PM
+ *
+ * The clk framework resumes the device around every operation that may
+ * access it and keeps it resumed while any output is prepared, so when
+ * the device suspends all outputs are powered down already. Keep the
+ * bus quiet while idle; accesses made meanwhile only hit the cache and
+ * are written back in a single sync on resume.
+ */
+static int si5351_runtime_suspend(struct device *dev)
+{
+	struct si5351_driver_data *drvdata = dev_get_drvdata(dev);
+
+	/* no status to read while the bus is quiet */
+	if (drvdata->irq) {
+		disable_irq_nosync(drvdata->irq);
+		si5351_reg_write(drvdata, SI5351_INTERRUPT_STATUS, 0);
+	}
+
+	regcache_cache_only(drvdata->regmap, true);
+
+	return 0;
+}
+
+static int si5351_runtime_resume(struct device *dev)
+{
+	struct si5351_driver_data *drvdata = dev_get_drvdata(dev);
+	int ret;
+
+	regcache_cache_only(drvdata->regmap, false);
+	ret = regcache_sync(drvdata->regmap);
+	if (ret) {
+		dev_err(dev, "failed to sync register cache: %d\n", ret);
+		regcache_cache_only(drvdata->regmap, true);
+		return ret;
+	}
+
+	if (drvdata->needs_relock) {
+		drvdata->needs_relock = false;
+		_si5351_pll_relock(drvdata);
+	}
+
+	/* a status latched meanwhile fires now, the line is level */
+	if (drvdata->irq)
+		enable_irq(drvdata->irq);
+
+	return 0;
+}
+
+/*
+ * The chip may lose power during system sleep: the whole register image
+ * is written back on resume, in as few bursts as the cache allows, and
+ * the PLLs are relocked afterwards.
+ */
+static int si5351_suspend(struct device *dev)
+{
+	struct si5351_driver_data *drvdata = dev_get_drvdata(dev);
+	int ret;
+
+	ret = pm_runtime_force_suspend(dev);
+	if (ret)
+		return ret;
+
+	regcache_mark_dirty(drvdata->regmap);
+	drvdata->needs_relock = true;
+
+	return 0;
+}
+
+static const struct dev_pm_ops si5351_pm_ops = {
+	SYSTEM_SLEEP_PM_OPS(si5351_suspend, pm_runtime_force_resume)
+	RUNTIME_PM_OPS(si5351_runtime_suspend, si5351_runtime_resume, NULL)
+};
+
+/*
+ * Si5351 status monitor
+ *
+ * Loss of lock, loss of signal and device resets (SYS_INIT, e.g. after
+ * a brownout) are picked up via the interrupt line if one is wired, or
+ * by polling otherwise. A reset chip is reprogrammed from the register
+ * cache. Consumers are told about every event through the notifier
+ * chain of the chip, with the status bits as action.
+ */
+static void si5351_check_status(struct si5351_driver_data *drvdata)
+{
+	struct device *dev = &drvdata->client->dev;
+	unsigned long events;
+	unsigned int v;
+	u8 status, sticky, reset, lol, mask;
+
+	status = si5351_reg_read(drvdata, SI5351_DEVICE_STATUS);
+	sticky = si5351_reg_read(drvdata, SI5351_INTERRUPT_STATUS);
+	si5351_reg_write(drvdata, SI5351_INTERRUPT_STATUS, 0);
+
+	/* only report the PLLs in use, and CLKIN loss while it feeds one */
+	_si5351_plls_in_use(drvdata, &reset, &lol);
+	lol &= ~READ_ONCE(drvdata->lol_settling);
+	mask = SI5351_STATUS_SYS_INIT | lol;
+	if (READ_ONCE(drvdata->los_armed))
+		mask |= SI5351_STATUS_LOS;
+
+	events = (status | sticky) & mask;
+	if (!events)
+		return;
+
+	dev_warn(dev, "status event 0x%02lx\n", events);
+
+	if (events & SI5351_STATUS_SYS_INIT) {
+		if (regmap_read_poll_timeout(drvdata->regmap,
+					     SI5351_DEVICE_STATUS, v,
+					     !(v & SI5351_STATUS_SYS_INIT),
+					     100, 20000) == 0) {
+			regcache_mark_dirty(drvdata->regmap);
+			if (regcache_sync(drvdata->regmap) == 0)
+				_si5351_pll_relock(drvdata);
+			else
+				dev_err(dev, "failed to reprogram device\n");
+		}
+	}
+
+	blocking_notifier_call_chain(&drvdata->notifier, events, dev);
+}
+
+/*
+ * The interrupt is disabled while suspended, so it can only fire while
+ * the chip is active or about to suspend. In the latter case resume it
+ * to clear the status, else the level interrupt would trigger again as
+ * soon as the oneshot thread returns.
+ */
+static irqreturn_t si5351_irq_thread(int irq, void *data)
+{
+	struct si5351_driver_data *drvdata = data;
+	struct device *dev = &drvdata->client->dev;
+
+	if (pm_runtime_resume_and_get(dev) < 0)
+		return IRQ_NONE;
+
+	si5351_check_status(drvdata);
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+	return IRQ_HANDLED;
+}
+
+static void si5351_status_work(struct work_struct *work)
+{
+	struct si5351_driver_data *drvdata = container_of(to_delayed_work(work),
+			struct si5351_driver_data, status_work);
+	struct device *dev = &drvdata->client->dev;
+
+	/* outputs are off while suspended, nothing to monitor */
+	if (pm_runtime_get_if_active(dev) > 0) {
+		si5351_check_status(drvdata);
+		pm_runtime_put(dev);
+	}
+
+	schedule_delayed_work(&drvdata->status_work,
+			      msecs_to_jiffies(status_poll_ms));
+}
+
+static void si5351_status_work_cancel(void *data)
+{
+	struct si5351_driver_data *drvdata = data;
+
+	cancel_delayed_work_sync(&drvdata->status_work);
+}
+
+static int si5351_monitor_init(struct si5351_driver_data *drvdata)
+{
+	struct device *dev = &drvdata->client->dev;
+	int irq = drvdata->client->irq;
+	/* LOS is unmasked while armed */
+	u8 mask = SI5351_STATUS_SYS_INIT | SI5351_STATUS_LOL_A |
+		  SI5351_STATUS_LOL_B;
+	int ret;
+
+	/* runtime suspend must not disable the interrupt before it exists */
+	ret = pm_runtime_resume_and_get(dev);
+	if (ret < 0)
+		return ret;
+
+	/* drop the status latched while powering up */
+	si5351_reg_write(drvdata, SI5351_INTERRUPT_STATUS, 0);
+
+	if (irq > 0) {
+		ret = devm_request_threaded_irq(dev, irq, NULL,
+						si5351_irq_thread, IRQF_ONESHOT,
+						dev_name(dev), drvdata);
+		if (ret) {
+			dev_err_probe(dev, ret, "failed to request irq\n");
+			goto out;
+		}
+
+		drvdata->irq = irq;
+		if (drvdata->los_armed)
+			mask |= SI5351_STATUS_LOS;
+		/* a set bit masks the interrupt */
+		si5351_reg_write(drvdata, SI5351_INTERRUPT_MASK, 0xf0 & ~mask);
+	} else if (status_poll_ms) {
+		INIT_DELAYED_WORK(&drvdata->status_work, si5351_status_work);
+		ret = devm_add_action_or_reset(dev, si5351_status_work_cancel,
+					       drvdata);
+		if (ret)
+			goto out;
+
+		schedule_delayed_work(&drvdata->status_work,
+				      msecs_to_jiffies(status_poll_ms));
+	}
+out:
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+	return ret;
+}
+
+static struct si5351_driver_data *si5351_clk_to_drvdata(struct clk *clk)
+{
+	struct clk_hw *hw = __clk_get_hw(clk);
+	struct si5351_driver_data *drvdata;
+
+	list_for_each_entry(drvdata, &si5351_instances, node) {
+		if (hw >= &drvdata->clkout[0].hw &&
+		    hw <= &drvdata->clkout[drvdata->num_clkout - 1].hw)
+			return drvdata;
+	}
+
+	return NULL;
+}
+
+/**
+ * si5351_clk_register_notifier - get notified about status events
+ * @clk: output clock of the Si5351 to monitor
+ * @nb: notifier block, called with the SI5351_STATUS_* bits as action
+ *
+ * Returns -ENODEV if @clk is not an output of a Si5351.
+ */
+int si5351_clk_register_notifier(struct clk *clk, struct notifier_block *nb)
+{
+	struct si5351_driver_data *drvdata;
+	int ret = -ENODEV;
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	if (drvdata)
+		ret = blocking_notifier_chain_register(&drvdata->notifier, nb);
+	mutex_unlock(&si5351_instances_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(si5351_clk_register_notifier);
+
+int si5351_clk_unregister_notifier(struct clk *clk, struct notifier_block *nb)
+{
+	struct si5351_driver_data *drvdata;
+	int ret = -ENODEV;
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	if (drvdata)
+		ret = blocking_notifier_chain_unregister(&drvdata->notifier,
+							 nb);
+	mutex_unlock(&si5351_instances_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(si5351_clk_unregister_notifier);
+
+/**
+ * si5351_clk_get_status - current status of the chip feeding a clock
+ * @clk: output clock of the Si5351
+ *
+ * Returns the SI5351_STATUS_* bits of the PLLs in use and of CLKIN
+ * while it feeds one of them (Si5351C only), 0 if all is locked, or a
+ * negative error code.
+ */
+int si5351_clk_get_status(struct clk *clk)
+{
+	struct si5351_driver_data *drvdata;
+	struct device *dev;
+	u8 status, reset, lol;
+	int ret;
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	mutex_unlock(&si5351_instances_lock);
+	if (!drvdata)
+		return -ENODEV;
+
+	dev = &drvdata->client->dev;
+	ret = pm_runtime_resume_and_get(dev);
+	if (ret < 0)
+		return ret;
+
+	status = si5351_reg_read(drvdata, SI5351_DEVICE_STATUS);
+	_si5351_plls_in_use(drvdata, &reset, &lol);
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+	if (READ_ONCE(drvdata->los_armed))
+		lol |= SI5351_STATUS_LOS;
+
+	return status & (SI5351_STATUS_SYS_INIT | lol);
+}
+EXPORT_SYMBOL_GPL(si5351_clk_get_status);
+
+/**
+ * si5351_clk_set_phase_ps - delay an output against the others of its PLL
+ * @clk: output clock 0..5 of the Si5351
+ * @ps: delay in ps, rounded to a quarter VCO period
+ *
+ * Unlike clk_set_phase() this is independent of the output rate, and so
+ * fine enough for board skew compensation of bit clocks.
+ */
+int si5351_clk_set_phase_ps(struct clk *clk, u32 ps)
+{
+	struct si5351_driver_data *drvdata;
+	struct clk_hw *hw = __clk_get_hw(clk);
+	struct device *dev;
+	int ret;
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	mutex_unlock(&si5351_instances_lock);
+	if (!drvdata)
+		return -ENODEV;
+
+	/* the PLL reset is volatile, it has to reach the chip */
+	dev = &drvdata->client->dev;
+	ret = pm_runtime_resume_and_get(dev);
+	if (ret < 0)
+		return ret;
+
+	ret = _si5351_clkout_set_phase_ps(
+			container_of(hw, struct si5351_hw_data, hw), ps);
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(si5351_clk_set_phase_ps);
+
+/**
+ * si5351_clk_oeb_hold - hold the OEB pin while outputs are started
+ * @clk: output clock of the Si5351
+ * @hold: true to hold the pin deasserted, false to release it again
+ *
+ * Outputs routed through the OEB pin that are prepared and enabled
+ * while the pin is held all start on the edge of its release. Holds
+ * nest. Returns -ENODEV if @clk is not an output of a Si5351, and 0
+ * without doing anything if the chip has no OEB pin.
+ */
+int si5351_clk_oeb_hold(struct clk *clk, bool hold)
+{
+	struct si5351_driver_data *drvdata;
+	unsigned long flags;
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	mutex_unlock(&si5351_instances_lock);
+	if (!drvdata)
+		return -ENODEV;
+	if (!drvdata->oeb_gpio)
+		return 0;
+
+	flags = si5351_oeb_lock(drvdata);
+	if (hold)
+		drvdata->oeb_hold++;
+	else if (!WARN_ON(drvdata->oeb_hold == 0))
+		drvdata->oeb_hold--;
+	_si5351_oeb_update(drvdata);
+	si5351_oeb_unlock(drvdata, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(si5351_clk_oeb_hold);
+
+/**
+ * si5351_clk_claim - take ownership of the chip feeding a clock
+ * @clk: output clock of the Si5351
+ * @owner: device of the consumer
+ *
+ * Profiles, PLL trim and phase offsets are kept per chip, so only one
+ * consumer may drive them. Claims by the same owner nest without
+ * counting. Returns -EBUSY if the chip is claimed by another device.
+ */
+int si5351_clk_claim(struct clk *clk, struct device *owner)
+{
+	struct si5351_driver_data *drvdata;
+	int ret = -ENODEV;
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	if (drvdata && drvdata->owner && drvdata->owner != owner) {
+		ret = -EBUSY;
+	} else if (drvdata) {
+		drvdata->owner = owner;
+		ret = 0;
+	}
+	mutex_unlock(&si5351_instances_lock);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(si5351_clk_claim);
+
+void si5351_clk_release(struct clk *clk, struct device *owner)
+{
+	struct si5351_driver_data *drvdata;
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	if (drvdata && drvdata->owner == owner)
+		drvdata->owner = NULL;
+	mutex_unlock(&si5351_instances_lock);
+}
+EXPORT_SYMBOL_GPL(si5351_clk_release);
+
+/*
+ * Si5351 register profiles
+ *
+ * Boards with a fixed clock plan can ship it as firmware files, one per
+ * rate family, listed in the firmware-name property. Each file is a
+ * register list as exported by ClockBuilder, one "reg,val" pair per line
+ * (val in hex, "0x" prefix or "h" suffix optional), '#' starts a comment.
+ * A profile is written in bursts of consecutive registers, and the clk
+ * framework re-reads the rates from the chip afterwards. The enable state
+ * of the outputs is left to the clk framework.
+ */
+static int si5351_profile_parse(struct device *dev, const struct firmware *fw,
+				struct si5351_profile *profile)
+{
+	const char *p = fw->data, *end = fw->data + fw->size;
+	const char *comment;
+	char line[32], *val;
+	unsigned int reg;
+	size_t len, eol;
+	u8 v;
+
+	while (p < end) {
+		eol = strnchrnul(p, end - p, '\n') - p;
+		/* comments may be long, only the data part has to fit */
+		comment = memchr(p, '#', eol);
+		len = comment ? comment - p : eol;
+		/* column headers may be long too, and never start with a digit */
+		while (len && isspace(*p)) {
+			p++;
+			eol--;
+			len--;
+		}
+		if (!len || !isdigit(*p)) {
+			p += eol + 1;
+			continue;
+		}
+
+		if (len >= sizeof(line)) {
+			dev_err(dev, "profile line too long\n");
+			return -EINVAL;
+		}
+		memcpy(line, p, len);
+		line[len] = '\0';
+		p += eol + 1;
+		strim(line);
+
+		val = strchr(line, ',');
+		if (!val)
+			goto err;
+		*val++ = '\0';
+		val = strim(val);
+		len = strlen(val);
+		if (len && tolower(val[len - 1]) == 'h')
+			val[len - 1] = '\0';
+
+		if (kstrtouint(strim(line), 10, &reg) || kstrtou8(val, 16, &v) ||
+		    reg >= SI5351_NUM_REGS)
+			goto err;
+
+		profile->val[reg] = v;
+		set_bit(reg, profile->mask);
+	}
+
+	return 0;
+err:
+	dev_err(dev, "invalid profile line '%s'\n", line);
+	return -EINVAL;
+}
+
+static int si5351_profiles_load(struct si5351_driver_data *drvdata)
+{
+	struct device *dev = &drvdata->client->dev;
+	const struct firmware *fw;
+	const char *names[SI5351_MAX_PROFILES];
+	int n, num, ret;
+
+	num = device_property_read_string_array(dev, "firmware-name", names,
+						ARRAY_SIZE(names));
+	if (num <= 0)
+		return 0;
+
+	drvdata->profiles = devm_kcalloc(dev, num, sizeof(*drvdata->profiles),
+					 GFP_KERNEL);
+	if (!drvdata->profiles)
+		return -ENOMEM;
+
+	for (n = 0; n < num; n++) {
+		ret = request_firmware(&fw, names[n], dev);
+		if (ret)
+			return dev_err_probe(dev, ret, "failed to load %s\n",
+					     names[n]);
+
+		ret = si5351_profile_parse(dev, fw, &drvdata->profiles[n]);
+		release_firmware(fw);
+		if (ret)
+			return ret;
+	}
+	drvdata->num_profiles = num;
+
+	return 0;
+}
+
+static bool si5351_profile_writeable(unsigned int reg)
+{
+	switch (reg) {
+	case SI5351_INTERRUPT_STATUS:
+	case SI5351_OUTPUT_ENABLE_CTRL:
+	case SI5351_PLL_RESET:
+		return false;
+	}
+
+	return si5351_regmap_is_writeable(NULL, reg);
+}
+
+static int _si5351_profile_apply(struct si5351_driver_data *drvdata,
+				 unsigned int index)
+{
+	struct si5351_profile *profile = &drvdata->profiles[index];
+	u8 buf[SI5351_NUM_REGS];
+	unsigned int reg, start;
+	u8 reset;
+	int n, ret;
+
+	/* keep the outputs powered as the clk framework left them */
+	memcpy(buf, profile->val, sizeof(buf));
+	for (n = 0; n < 8; n++) {
+		if (!test_bit(SI5351_CLK0_CTRL + n, profile->mask))
+			continue;
+		buf[SI5351_CLK0_CTRL + n] &= ~SI5351_CLK_POWERDOWN;
+		buf[SI5351_CLK0_CTRL + n] |= SI5351_CLK_POWERDOWN &
+			si5351_reg_read(drvdata, SI5351_CLK0_CTRL + n);
+	}
+
+	for (reg = 0; reg < SI5351_NUM_REGS; reg++) {
+		if (!test_bit(reg, profile->mask) ||
+		    !si5351_profile_writeable(reg))
+			continue;
+
+		start = reg;
+		while (reg + 1 < SI5351_NUM_REGS &&
+		       test_bit(reg + 1, profile->mask) &&
+		       si5351_profile_writeable(reg + 1))
+			reg++;
+
+		ret = si5351_bulk_write(drvdata, start, reg - start + 1,
+					&buf[start]);
+		if (ret)
+			return ret;
+	}
+
+	/* make recalc_rate read back what was written */
+	for (n = 0; n < 2; n++) {
+		drvdata->pll[n].params.valid = 0;
+		drvdata->pll_nominal[n].valid = 0;
+		drvdata->pll_trim[n] = 0;
+	}
+	for (n = 0; drvdata->msynth && n < drvdata->num_clkout; n++)
+		drvdata->msynth[n].params.valid = 0;
+
+	/* reset and wait for the PLLs the profile configures */
+	reset = 0;
+	if (test_bit(SI5351_PLLA_PARAMETERS, profile->mask))
+		reset |= SI5351_PLL_RESET_A;
+	if (test_bit(SI5351_PLLB_PARAMETERS, profile->mask))
+		reset |= SI5351_PLL_RESET_B;
+	if (!reset)
+		return 0;
+
+	_si5351_pll_reset(drvdata, reset);
+	ret = _si5351_pll_settle(drvdata, reset);
+	if (ret)
+		dev_err(&drvdata->client->dev,
+			"PLLs did not lock after profile %u\n", index);
+
+	return ret;
+}
+
+/**
+ * si5351_clk_apply_profile - switch to another firmware register profile
+ * @clk: output clock of the Si5351
+ * @index: profile index in the firmware-name list
+ *
+ * Returns -ENOENT if there is no such profile. The topology (clock
+ * parents) must be the same in all profiles.
+ */
+int si5351_clk_apply_profile(struct clk *clk, unsigned int index)
+{
+	struct si5351_driver_data *drvdata;
+	struct device *dev;
+	int n, ret;
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	mutex_unlock(&si5351_instances_lock);
+	if (!drvdata)
+		return -ENODEV;
+
+	if (index >= drvdata->num_profiles)
+		return -ENOENT;
+
+	dev = &drvdata->client->dev;
+	ret = pm_runtime_resume_and_get(dev);
+	if (ret < 0)
+		return ret;
+
+	/* same lock order as the PLL set_rate */
+	mutex_lock(&drvdata->phase_lock);
+	mutex_lock(&drvdata->trim_lock);
+	ret = _si5351_profile_apply(drvdata, index);
+	mutex_unlock(&drvdata->trim_lock);
+	mutex_unlock(&drvdata->phase_lock);
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+	if (ret)
+		return ret;
+
+	/* PLLs don't cache their rate, this updates the whole tree */
+	for (n = 0; n < 2; n++)
+		clk_get_rate(drvdata->pll[n].hw.clk);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(si5351_clk_apply_profile);
+
+/*
+ * Si5351 clock trim
+ *
+ * Pulls the PLL feeding an output by a few ppm, e.g. to follow a network
+ * clock. Only the feedback multisynth parameters are rewritten, in one
+ * burst and without a PLL reset, so the PLL glides to the new rate and
+ * the output dividers are left alone.
+ *
+ * Clocks not derived from the PLL, like the reference on XTAL or CLKIN,
+ * are not pulled along. Consumers that need them in step check with
+ * si5351_clk_trim_check() first.
+ */
+static struct si5351_hw_data *si5351_clk_to_pll(
+	struct si5351_driver_data *drvdata, struct clk *clk)
+{
+	struct clk_hw *hw = __clk_get_hw(clk);
+	int n;
+
+	/* clkout -> msynth -> pll */
+	hw = clk_hw_get_parent(hw);
+	if (hw)
+		hw = clk_hw_get_parent(hw);
+
+	for (n = 0; n < 2; n++)
+		if (hw == &drvdata->pll[n].hw)
+			return &drvdata->pll[n];
+
+	return NULL;
+}
+
+static int _si5351_pll_trim(struct si5351_driver_data *drvdata,
+			    struct si5351_hw_data *pll, int ppb)
+{
+	struct si5351_parameters *nominal = &drvdata->pll_nominal[pll->num];
+	struct si5351_parameters params;
+	u8 reg = (pll->num == 0) ? SI5351_PLLA_PARAMETERS :
+		SI5351_PLLB_PARAMETERS;
+	u64 x;
+	s64 delta;
+
+	/* PLL not set up by us, trim what the hardware runs with */
+	if (!nominal->valid)
+		si5351_read_parameters(drvdata, reg, nominal);
+	if (!nominal->p3)
+		return -EINVAL;
+
+	if (ppb == 0) {
+		params = *nominal;
+	} else {
+		/*
+		 * fVCO = fIN * X/(128*P3) with X = (P1 + 512)*P3 + P2.
+		 * Rescale to P3 = 10^6 to get a fine enough step, then
+		 * pull X by ppb.
+		 */
+		x = (u64)(nominal->p1 + 512) * SI5351_TRIM_DENOM;
+		x += div_u64((u64)nominal->p2 * SI5351_TRIM_DENOM,
+			     nominal->p3);
+		delta = div_s64((s64)x * ppb, 1000000000);
+		x += delta;
+
+		params.p3 = SI5351_TRIM_DENOM;
+		params.p2 = do_div(x, SI5351_TRIM_DENOM);
+		params.p1 = x - 512;
+		params.valid = 1;
+	}
+
+	/* leave integer mode before the fraction becomes non-zero */
+	if (!si5351_pll_integer_mode(pll, &params))
+		si5351_set_bits(drvdata, SI5351_CLK6_CTRL + pll->num,
+				SI5351_CLK_INTEGER_MODE, 0);
+
+	si5351_write_parameters(drvdata, reg, &params);
+
+	if (si5351_pll_integer_mode(pll, &params))
+		si5351_set_bits(drvdata, SI5351_CLK6_CTRL + pll->num,
+				SI5351_CLK_INTEGER_MODE,
+				SI5351_CLK_INTEGER_MODE);
+
+	pll->params = params;
+	drvdata->pll_trim[pll->num] = ppb;
+
+	return 0;
+}
+
+/**
+ * si5351_clk_set_trim - pull the PLL feeding an output
+ * @clk: output clock of the Si5351
+ * @ppb: offset from the nominal PLL rate in parts per billion, limited
+ *	 to +-SI5351_TRIM_MAX_PPB
+ *
+ * The trim applies to every output sharing the PLL and is dropped when
+ * the PLL rate is set again. The cached clk rate is not updated.
+ */
+int si5351_clk_set_trim(struct clk *clk, int ppb)
+{
+	struct si5351_driver_data *drvdata;
+	struct si5351_hw_data *pll;
+	struct device *dev;
+	int ret;
+
+	ppb = clamp(ppb, -SI5351_TRIM_MAX_PPB, SI5351_TRIM_MAX_PPB);
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	mutex_unlock(&si5351_instances_lock);
+	if (!drvdata)
+		return -ENODEV;
+
+	pll = si5351_clk_to_pll(drvdata, clk);
+	if (!pll)
+		return -EINVAL;
+
+	dev = &drvdata->client->dev;
+	ret = pm_runtime_resume_and_get(dev);
+	if (ret < 0)
+		return ret;
+
+	mutex_lock(&drvdata->trim_lock);
+	if (drvdata->pll_trim[pll->num] != ppb) {
+		ret = _si5351_pll_trim(drvdata, pll, ppb);
+		dev_dbg(dev, "%s: trim = %d ppb\n",
+			clk_hw_get_name(&pll->hw), ppb);
+	}
+	mutex_unlock(&drvdata->trim_lock);
+
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(si5351_clk_set_trim);
+
+int si5351_clk_get_trim(struct clk *clk, int *ppb)
+{
+	struct si5351_driver_data *drvdata;
+	struct si5351_hw_data *pll;
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	mutex_unlock(&si5351_instances_lock);
+	if (!drvdata)
+		return -ENODEV;
+
+	pll = si5351_clk_to_pll(drvdata, clk);
+	if (!pll)
+		return -EINVAL;
+
+	mutex_lock(&drvdata->trim_lock);
+	*ppb = drvdata->pll_trim[pll->num];
+	mutex_unlock(&drvdata->trim_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(si5351_clk_get_trim);
+
+/**
+ * si5351_clk_trim_check - check that a trim moves a reference clock along
+ * @clk: output clock of the Si5351 to be trimmed
+ * @ref: clock that has to stay in step with @clk, e.g. a master clock
+ *
+ * Returns 0 if @ref is an output fed by the same PLL as @clk, -EBUSY if
+ * it is an output of the same chip fed otherwise, and -EOPNOTSUPP if it
+ * does not come from the chip at all, e.g. a crystal oscillator that
+ * also drives CLKIN.
+ */
+int si5351_clk_trim_check(struct clk *clk, struct clk *ref)
+{
+	struct si5351_driver_data *drvdata, *refdata;
+	struct si5351_hw_data *pll;
+
+	mutex_lock(&si5351_instances_lock);
+	drvdata = si5351_clk_to_drvdata(clk);
+	refdata = ref ? si5351_clk_to_drvdata(ref) : NULL;
+	mutex_unlock(&si5351_instances_lock);
+	if (!drvdata)
+		return -ENODEV;
+	if (refdata != drvdata)
+		return -EOPNOTSUPP;
+
+	pll = si5351_clk_to_pll(drvdata, clk);
+	if (!pll || si5351_clk_to_pll(drvdata, ref) != pll)
+		return -EBUSY;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(si5351_clk_trim_check);
+
+static void si5351_instance_remove(void *data)
+{
+	struct si5351_driver_data *drvdata = data;
+
+	mutex_lock(&si5351_instances_lock);
+	list_del(&drvdata->node);
+	mutex_unlock(&si5351_instances_lock);
 }
 
-static int si5351_clkout_set_parent(struct clk_hw *hw, u8 index)
+/*
+ * debugfs clk_plan: the programmed parameters of every PLL, multisynth
+ * and output, the rate they give and its error against the last request.
+ * Rates are kept in 1/65536 Hz so the error is exact down to ppb.
+ */
+#define SI5351_PLAN_SHIFT	16
+
+static u64 si5351_plan_pll_rate(u64 parent_q, struct si5351_parameters *p)
 {
-	struct si5351_hw_data *hwdata =
-		container_of(hw, struct si5351_hw_data, hw);
-	enum si5351_clkout_src parent = SI5351_CLKOUT_SRC_DEFAULT;
+	/* fVCO = fIN * (P1*P3 + 512*P3 + P2)/(128*P3) */
+	if (!p->p3)
+		return parent_q;
+	return mul_u64_u64_div_u64(parent_q,
+				   (u64)p->p1 * p->p3 + 512ULL * p->p3 + p->p2,
+				   128ULL * p->p3);
+}
 
-	switch (index) {
-	case 0:
-		parent = SI5351_CLKOUT_SRC_MSYNTH_N;
-		break;
-	case 1:
-		parent = SI5351_CLKOUT_SRC_MSYNTH_0_4;
-		break;
-	case 2:
-		parent = SI5351_CLKOUT_SRC_XTAL;
-		break;
-	case 3:
-		parent = SI5351_CLKOUT_SRC_CLKIN;
-		break;
+static u64 si5351_plan_msynth_rate(u64 parent_q, struct si5351_parameters *p,
+				   unsigned char num, bool divby4)
+{
+	u64 m;
+
+	if (num > 5)
+		m = p->p1;
+	else if (divby4)
+		m = 4;
+	else if (!p->p3)
+		return parent_q;
+	else
+		return mul_u64_u64_div_u64(parent_q, 128ULL * p->p3,
+				(u64)p->p1 * p->p3 + p->p2 + 512ULL * p->p3);
+
+	return m ? div64_u64(parent_q, m) : 0;
+}
+
+/* 1 if the cache matches the chip, 0 if not, or a negative errno */
+static int si5351_plan_regs_match(struct si5351_driver_data *drvdata,
+				  u8 reg, unsigned int len)
+{
+	unsigned int cached, val;
+	int ret;
+
+	for (; len; reg++, len--) {
+		ret = regmap_read(drvdata->regmap, reg, &cached);
+		if (!ret)
+			ret = regmap_read_bypassed(drvdata->regmap, reg, &val);
+		if (ret)
+			return ret;
+		if (cached != val)
+			return 0;
 	}
 
-	return _si5351_clkout_reparent(hwdata->drvdata, hwdata->num, parent);
+	return 1;
 }
 
-static unsigned long si5351_clkout_recalc_rate(struct clk_hw *hw,
-					       unsigned long parent_rate)
+static void si5351_plan_show_row(struct seq_file *s, struct clk_hw *hw,
+				 unsigned long req, u64 rate_q,
+				 struct si5351_parameters *p,
+				 const char *mode, int match)
 {
-	struct si5351_hw_data *hwdata =
-		container_of(hw, struct si5351_hw_data, hw);
-	unsigned char reg;
-	unsigned char rdiv;
+	u64 req_q = (u64)req << SI5351_PLAN_SHIFT;
+	u64 frac = rate_q & (BIT_ULL(SI5351_PLAN_SHIFT) - 1);
+	char err[24] = "-";
 
-	if (hwdata->num <= 5)
-		reg = si5351_msynth_params_address(hwdata->num) + 2;
-	else
-		reg = SI5351_CLK6_7_OUTPUT_DIVIDER;
+	if (req) {
+		u64 ppb = mul_u64_u64_div_u64(rate_q > req_q ? rate_q - req_q :
+					      req_q - rate_q, NSEC_PER_SEC,
+					      req_q);
 
-	rdiv = si5351_reg_read(hwdata->drvdata, reg);
-	if (hwdata->num == 6) {
-		rdiv &= SI5351_OUTPUT_CLK6_DIV_MASK;
-	} else {
-		rdiv &= SI5351_OUTPUT_CLK_DIV_MASK;
-		rdiv >>= SI5351_OUTPUT_CLK_DIV_SHIFT;
+		snprintf(err, sizeof(err), "%c%llu",
+			 rate_q < req_q ? '-' : '+', ppb);
 	}
 
-	return parent_rate >> rdiv;
+	seq_printf(s, "%-12s %10lu %10llu.%06llu %12s",
+		   clk_hw_get_name(hw), req, rate_q >> SI5351_PLAN_SHIFT,
+		   (frac * USEC_PER_SEC) >> SI5351_PLAN_SHIFT, err);
+	if (p)
+		seq_printf(s, " %7lu %7lu %7lu", p->p1, p->p2, p->p3);
+	else
+		seq_printf(s, " %7s %7s %7s", "-", "-", "-");
+	seq_printf(s, " %-10s %s\n", mode,
+		   match < 0 ? "-" : match ? "ok" : "MISMATCH");
 }
 
-static int si5351_clkout_determine_rate(struct clk_hw *hw,
-					struct clk_rate_request *req)
+static int si5351_plan_show(struct seq_file *s, void *data)
 {
-	struct si5351_hw_data *hwdata =
-		container_of(hw, struct si5351_hw_data, hw);
-	unsigned long rate = req->rate;
-	unsigned char rdiv;
+	struct si5351_driver_data *drvdata = s->private;
+	struct device *dev = &drvdata->client->dev;
+	struct si5351_parameters p;
+	struct clk_hw *parent;
+	u64 pll_q[2], ms_q[8], rate_q;
+	char mode[16];
+	bool active, divby4;
+	int n, match;
+	u8 reg, ctrl, rdiv;
+
+	/* the chip can only be compared with the cache while resumed */
+	active = pm_runtime_get_if_active(dev) > 0;
+
+	seq_printf(s, "%-12s %10s %17s %12s %7s %7s %7s %-10s %s\n",
+		   "clock", "requested", "achieved", "error_ppb",
+		   "p1", "p2", "p3", "mode", "regs");
 
-	/* clkout6/7 can only handle output freqencies < 150MHz */
-	if (hwdata->num >= 6 && rate > SI5351_CLKOUT67_MAX_FREQ)
-		rate = SI5351_CLKOUT67_MAX_FREQ;
+	for (n = 0; n < 2; n++) {
+		struct si5351_hw_data *hwdata = &drvdata->pll[n];
+
+		reg = n ? SI5351_PLLB_PARAMETERS : SI5351_PLLA_PARAMETERS;
+		si5351_read_parameters(drvdata, reg, &p);
+		ctrl = si5351_reg_read(drvdata, SI5351_CLK6_CTRL + n);
+
+		parent = clk_hw_get_parent(&hwdata->hw);
+		pll_q[n] = si5351_plan_pll_rate((u64)clk_hw_get_rate(parent) <<
+						SI5351_PLAN_SHIFT, &p);
+
+		match = -ENODEV;
+		if (active) {
+			match = si5351_plan_regs_match(drvdata, reg,
+						SI5351_PARAMETERS_LENGTH);
+			if (match > 0)
+				match = si5351_plan_regs_match(drvdata,
+						SI5351_CLK6_CTRL + n, 1);
+		}
 
-	/* clkout freqency is 8kHz - 160MHz */
-	if (rate > SI5351_CLKOUT_MAX_FREQ)
-		rate = SI5351_CLKOUT_MAX_FREQ;
-	if (rate < SI5351_CLKOUT_MIN_FREQ)
-		rate = SI5351_CLKOUT_MIN_FREQ;
+		si5351_plan_show_row(s, &hwdata->hw, hwdata->req_rate,
+				     pll_q[n], &p,
+				     (ctrl & SI5351_CLK_INTEGER_MODE) ?
+				     "int" : "frac", match);
+	}
 
-	/* request frequency if multisync master */
-	if (clk_hw_get_flags(hw) & CLK_SET_RATE_PARENT) {
-		/* use r divider for frequencies below 1MHz */
-		rdiv = SI5351_OUTPUT_CLK_DIV_1;
-		while (rate < SI5351_MULTISYNTH_MIN_FREQ &&
-		       rdiv < SI5351_OUTPUT_CLK_DIV_128) {
-			rdiv += 1;
-			rate *= 2;
+	for (n = 0; n < drvdata->num_clkout; n++) {
+		struct si5351_hw_data *hwdata = &drvdata->msynth[n];
+
+		reg = si5351_msynth_params_address(n);
+		si5351_read_parameters(drvdata, reg, &p);
+		ctrl = si5351_reg_read(drvdata, SI5351_CLK0_CTRL + n);
+		divby4 = n <= 5 && (si5351_reg_read(drvdata, reg + 2) &
+				    SI5351_OUTPUT_CLK_DIVBY4) ==
+				   SI5351_OUTPUT_CLK_DIVBY4;
+
+		parent = clk_hw_get_parent(&hwdata->hw);
+		rate_q = parent == &drvdata->pll[1].hw ? pll_q[1] : pll_q[0];
+		ms_q[n] = si5351_plan_msynth_rate(rate_q, &p, n, divby4);
+
+		match = -ENODEV;
+		if (active) {
+			match = si5351_plan_regs_match(drvdata, reg,
+					n > 5 ? 1 : SI5351_PARAMETERS_LENGTH);
+			if (match > 0)
+				match = si5351_plan_regs_match(drvdata,
+						SI5351_CLK0_CTRL + n, 1);
 		}
-		req->best_parent_rate = rate;
-	} else {
-		unsigned long new_rate, new_err, err;
-
-		/* round to closed rdiv */
-		rdiv = SI5351_OUTPUT_CLK_DIV_1;
-		new_rate = req->best_parent_rate;
-		err = abs(new_rate - rate);
-		do {
-			new_rate >>= 1;
-			new_err = abs(new_rate - rate);
-			if (new_err > err || rdiv == SI5351_OUTPUT_CLK_DIV_128)
-				break;
-			rdiv++;
-			err = new_err;
-		} while (1);
+
+		snprintf(mode, sizeof(mode), "%s%s",
+			 (ctrl & SI5351_CLK_INTEGER_MODE) ? "int" : "frac",
+			 divby4 ? ",div4" : "");
+		si5351_plan_show_row(s, &hwdata->hw, hwdata->req_rate,
+				     ms_q[n], &p, mode, match);
 	}
-	rate = req->best_parent_rate >> rdiv;
 
-	dev_dbg(&hwdata->drvdata->client->dev,
-		"%s - %s: rdiv = %u, parent_rate = %lu, rate = %lu\n",
-		__func__, clk_hw_get_name(hw), (1 << rdiv),
-		req->best_parent_rate, rate);
+	for (n = 0; n < drvdata->num_clkout; n++) {
+		struct si5351_hw_data *hwdata = &drvdata->clkout[n];
+
+		if (n <= 5)
+			reg = si5351_msynth_params_address(n) + 2;
+		else
+			reg = SI5351_CLK6_7_OUTPUT_DIVIDER;
+
+		rdiv = si5351_reg_read(drvdata, reg);
+		if (n == 6) {
+			rdiv &= SI5351_OUTPUT_CLK6_DIV_MASK;
+		} else {
+			rdiv &= SI5351_OUTPUT_CLK_DIV_MASK;
+			rdiv >>= SI5351_OUTPUT_CLK_DIV_SHIFT;
+		}
+
+		/* outputs may also run straight off xtal or clkin */
+		parent = clk_hw_get_parent(&hwdata->hw);
+		if (parent == &drvdata->msynth[n].hw)
+			rate_q = ms_q[n];
+		else
+			rate_q = (u64)clk_hw_get_rate(parent) <<
+				 SI5351_PLAN_SHIFT;
+
+		match = -ENODEV;
+		if (active) {
+			match = si5351_plan_regs_match(drvdata, reg, 1);
+			if (match > 0)
+				match = si5351_plan_regs_match(drvdata,
+						SI5351_CLK0_CTRL + n, 1);
+		}
+
+		snprintf(mode, sizeof(mode), "rdiv=%u", 1U << rdiv);
+		si5351_plan_show_row(s, &hwdata->hw, hwdata->req_rate,
+				     rate_q >> rdiv, NULL, mode, match);
+	}
+
+	if (active)
+		pm_runtime_put(dev);
 
-	req->rate = rate;
 	return 0;
 }
+DEFINE_SHOW_ATTRIBUTE(si5351_plan);
 
-static int si5351_clkout_set_rate(struct clk_hw *hw, unsigned long rate,
-				  unsigned long parent_rate)
+static void si5351_debugfs_remove(void *data)
 {
-	struct si5351_hw_data *hwdata =
-		container_of(hw, struct si5351_hw_data, hw);
-	unsigned long new_rate, new_err, err;
-	unsigned char rdiv;
-
-	/* round to closed rdiv */
-	rdiv = SI5351_OUTPUT_CLK_DIV_1;
-	new_rate = parent_rate;
-	err = abs(new_rate - rate);
-	do {
-		new_rate >>= 1;
-		new_err = abs(new_rate - rate);
-		if (new_err > err || rdiv == SI5351_OUTPUT_CLK_DIV_128)
-			break;
-		rdiv++;
-		err = new_err;
-	} while (1);
+	struct si5351_driver_data *drvdata = data;
 
-	/* write output divider */
-	switch (hwdata->num) {
-	case 6:
-		si5351_set_bits(hwdata->drvdata, SI5351_CLK6_7_OUTPUT_DIVIDER,
-				SI5351_OUTPUT_CLK6_DIV_MASK, rdiv);
-		break;
-	case 7:
-		si5351_set_bits(hwdata->drvdata, SI5351_CLK6_7_OUTPUT_DIVIDER,
-				SI5351_OUTPUT_CLK_DIV_MASK,
-				rdiv << SI5351_OUTPUT_CLK_DIV_SHIFT);
-		break;
-	default:
-		si5351_set_bits(hwdata->drvdata,
-				si5351_msynth_params_address(hwdata->num) + 2,
-				SI5351_OUTPUT_CLK_DIV_MASK,
-				rdiv << SI5351_OUTPUT_CLK_DIV_SHIFT);
-	}
+	debugfs_remove_recursive(drvdata->debugfs);
+}
 
-	/* powerup clkout */
-	si5351_set_bits(hwdata->drvdata, SI5351_CLK0_CTRL + hwdata->num,
-			SI5351_CLK_POWERDOWN, 0);
+static int si5351_debugfs_init(struct si5351_driver_data *drvdata)
+{
+	struct device *dev = &drvdata->client->dev;
+	char name[32];
 
-	dev_dbg(&hwdata->drvdata->client->dev,
-		"%s - %s: rdiv = %u, parent_rate = %lu, rate = %lu\n",
-		__func__, clk_hw_get_name(hw), (1 << rdiv),
-		parent_rate, rate);
+	snprintf(name, sizeof(name), "si5351-%s", dev_name(dev));
+	drvdata->debugfs = debugfs_create_dir(name, NULL);
+	debugfs_create_file("clk_plan", 0444, drvdata->debugfs, drvdata,
+			    &si5351_plan_fops);
+	taudac_regmap_stats_debugfs(drvdata->i2c_stats, drvdata->debugfs);
 
-	return 0;
+	return devm_add_action_or_reset(dev, si5351_debugfs_remove, drvdata);
 }
 
-static const struct clk_ops si5351_clkout_ops = {
-	.prepare = si5351_clkout_prepare,
-	.unprepare = si5351_clkout_unprepare,
-	.set_parent = si5351_clkout_set_parent,
-	.get_parent = si5351_clkout_get_parent,
-	.recalc_rate = si5351_clkout_recalc_rate,
-	.determine_rate = si5351_clkout_determine_rate,
-	.set_rate = si5351_clkout_set_rate,
-};
-
 /*
  * Si5351 i2c probe and DT
  */
@@ -1408,6 +2890,66 @@ put_child:
 	return -EINVAL;
 }
 
+/*
+ * per clkout property silabs,oeb-control : route the output through the
+ * OEB pin, i.e. enable/disable it together with the other routed outputs
+ */
+static u8 si5351_dt_parse_oeb(struct i2c_client *client)
+{
+	struct device_node *child, *np = client->dev.of_node;
+	u8 mask = 0;
+	u32 num;
+
+	if (np == NULL)
+		return 0;
+
+	for_each_child_of_node(np, child) {
+		if (of_property_read_u32(child, "reg", &num) || num >= 8)
+			continue;
+
+		if (of_property_read_bool(child, "silabs,oeb-control"))
+			mask |= (1 << num);
+	}
+
+	return mask;
+}
+
+/*
+ * property silabs,vcxo-pull-range-ppm : absolute pull range of the
+ * Si5351B VCXO, 0 leaves the VC pin without effect
+ */
+static unsigned int si5351_dt_parse_vcxo(struct i2c_client *client)
+{
+	u32 apr = 0;
+
+	if (client->dev.of_node)
+		of_property_read_u32(client->dev.of_node,
+				     "silabs,vcxo-pull-range-ppm", &apr);
+
+	return apr;
+}
+
+/*
+ * per clkout property silabs,phase-offset-ps : delay of clk0..5 against
+ * the other outputs of the same PLL
+ */
+static void si5351_dt_parse_phase(struct i2c_client *client, u32 *phase_ps)
+{
+	struct device_node *child, *np = client->dev.of_node;
+	u32 num;
+
+	if (np == NULL)
+		return;
+
+	for_each_child_of_node(np, child) {
+		if (of_property_read_u32(child, "reg", &num) || num > 5)
+			continue;
+
+		of_property_read_u32(child, "silabs,phase-offset-ps",
+				     &phase_ps[num]);
+	}
+}
+
 static struct clk_hw *
 si53351_of_clk_get(struct of_phandle_args *clkspec, void *data)
 {
@@ -1427,6 +2969,20 @@ static int si5351_dt_parse(struct i2c_client *client, enum si5351_variant varian
 	return 0;
 }
 
+static u8 si5351_dt_parse_oeb(struct i2c_client *client)
+{
+	return 0;
+}
+
+static unsigned int si5351_dt_parse_vcxo(struct i2c_client *client)
+{
+	return 0;
+}
+
+static void si5351_dt_parse_phase(struct i2c_client *client, u32 *phase_ps)
+{
+}
+
 static struct clk_hw *
 si53351_of_clk_get(struct of_phandle_args *clkspec, void *data)
 {
@@ -1443,6 +2999,91 @@ static const struct i2c_device_id si5351_i2c_ids[] = {
 };
 MODULE_DEVICE_TABLE(i2c, si5351_i2c_ids);
 
+/*
+ * Set the initial rates from DT in one go: outputs that are PLL masters
+ * first, so the others do not retune a PLL that is set up already. The
+ * registers are only collected in the cache meanwhile, and then written
+ * in a single pass, followed by one reset of the PLLs involved.
+ */
+static int si5351_set_initial_rates(struct si5351_driver_data *drvdata,
+				    struct si5351_platform_data *pdata)
+{
+	struct device *dev = &drvdata->client->dev;
+	static const u8 rmw_regs[] = {
+		SI5351_OUTPUT_ENABLE_CTRL, SI5351_CLK6_CTRL, SI5351_CLK7_CTRL,
+		SI5351_CLK6_7_OUTPUT_DIVIDER,
+	};
+	/* the registers set_rate may write */
+	static const struct regmap_range sync_ranges[] = {
+		regmap_reg_range(SI5351_OUTPUT_ENABLE_CTRL,
+				 SI5351_OUTPUT_ENABLE_CTRL),
+		regmap_reg_range(SI5351_PLL_INPUT_SOURCE,
+				 SI5351_CLK6_7_OUTPUT_DIVIDER),
+		regmap_reg_range(SI5351_CLK0_PHASE_OFFSET,
+				 SI5351_CLK5_PHASE_OFFSET),
+	};
+	bool master;
+	int n, ret;
+
+	/*
+	 * The chip must neither suspend nor resume while the cache is
+	 * used for staging, both switch the cache mode themselves.
+	 */
+	ret = pm_runtime_resume_and_get(dev);
+	if (ret < 0)
+		return ret;
+
+	/*
+	 * Registers of the clocks are cached by their registration, make
+	 * sure the few shared ones updated by set_rate are cached as well.
+	 */
+	for (n = 0; n < ARRAY_SIZE(rmw_regs); n++)
+		si5351_reg_read(drvdata, rmw_regs[n]);
+
+	regcache_cache_only(drvdata->regmap, true);
+	drvdata->defer_pll_reset = true;
+
+	for (master = true; ; master = false) {
+		for (n = 0; n < drvdata->num_clkout; n++) {
+			if (pdata->clkout[n].rate == 0 ||
+			    pdata->clkout[n].pll_master != master)
+				continue;
+
+			ret = clk_set_rate(drvdata->clkout[n].hw.clk,
+					   pdata->clkout[n].rate);
+			if (ret != 0)
+				dev_err(dev, "Cannot set rate : %d\n", ret);
+		}
+		if (!master)
+			break;
+	}
+
+	drvdata->defer_pll_reset = false;
+	regcache_cache_only(drvdata->regmap, false);
+
+	for (n = 0; n < ARRAY_SIZE(sync_ranges); n++) {
+		ret = regcache_sync_region(drvdata->regmap,
+					   sync_ranges[n].range_min,
+					   sync_ranges[n].range_max);
+		if (ret) {
+			dev_err(dev, "failed to write initial rates\n");
+			goto out;
+		}
+	}
+
+	if (drvdata->pll_reset_pending) {
+		_si5351_pll_reset(drvdata, drvdata->pll_reset_pending);
+		_si5351_pll_settle(drvdata, drvdata->pll_reset_pending);
+		drvdata->pll_reset_pending = 0;
+	}
+
+out:
+	pm_runtime_mark_last_busy(dev);
+	pm_runtime_put_autosuspend(dev);
+
+	return ret;
+}
+
 static int si5351_i2c_probe(struct i2c_client *client)
 {
 	enum si5351_variant variant;
@@ -1469,6 +3110,8 @@ static int si5351_i2c_probe(struct i2c_client *client)
 	i2c_set_clientdata(client, drvdata);
 	drvdata->client = client;
 	drvdata->variant = variant;
+	mutex_init(&drvdata->trim_lock);
+	mutex_init(&drvdata->phase_lock);
 	drvdata->pxtal = devm_clk_get(&client->dev, "xtal");
 	drvdata->pclkin = devm_clk_get(&client->dev, "clkin");
 
@@ -1486,13 +3129,48 @@ static int si5351_i2c_probe(struct i2c_client *client)
 		return -EINVAL;
 	}
 
-	drvdata->regmap = devm_regmap_init_i2c(client, &si5351_regmap_config);
+	drvdata->regmap = devm_taudac_regmap_init_i2c(client,
+					&si5351_regmap_config, si5351_i2c_ranges,
+					ARRAY_SIZE(si5351_i2c_ranges),
+					&drvdata->i2c_stats);
 	if (IS_ERR(drvdata->regmap)) {
 		dev_err(&client->dev, "failed to allocate register map\n");
 		return PTR_ERR(drvdata->regmap);
 	}
 
-	/* Disable interrupts */
+	/*
+	 * Optional OEB pin, described as active low: asserting it enables
+	 * the outputs routed through it. Start with the outputs disabled.
+	 */
+	drvdata->oeb_gpio = devm_gpiod_get_optional(&client->dev, "oeb",
+						    GPIOD_OUT_LOW);
+	if (IS_ERR(drvdata->oeb_gpio))
+		return dev_err_probe(&client->dev, PTR_ERR(drvdata->oeb_gpio),
+				     "failed to get oeb gpio\n");
+
+	mutex_init(&drvdata->oeb_mutex);
+	spin_lock_init(&drvdata->oeb_spinlock);
+	if (drvdata->oeb_gpio) {
+		drvdata->oeb_mask = si5351_dt_parse_oeb(client);
+		/* a cleared bit lets the OEB pin control the output */
+		si5351_reg_write(drvdata, SI5351_OEB_PIN_ENABLE_CTRL,
+				 (u8)~drvdata->oeb_mask);
+	}
+
+	si5351_dt_parse_phase(client, drvdata->phase_ps);
+
+	if (variant == SI5351_VARIANT_B) {
+		drvdata->vcxo_apr = si5351_dt_parse_vcxo(client);
+		if (drvdata->vcxo_apr &&
+		    (drvdata->vcxo_apr < SI5351_VXCO_APR_MIN ||
+		     drvdata->vcxo_apr > SI5351_VXCO_APR_MAX)) {
+			dev_err(&client->dev, "invalid VCXO pull range %u ppm\n",
+				drvdata->vcxo_apr);
+			return -EINVAL;
+		}
+	}
+
+	/* Disable interrupts, the status monitor may unmask some */
 	si5351_reg_write(drvdata, SI5351_INTERRUPT_MASK, 0xf0);
 	/* Ensure pll select is on XTAL for Si5351A/B */
 	if (drvdata->variant != SI5351_VARIANT_C)
@@ -1548,6 +3226,32 @@ static int si5351_i2c_probe(struct i2c_client *client)
 		}
 	}
 
+	/* a register profile overrides the configuration from DT */
+	ret = si5351_profiles_load(drvdata);
+	if (ret)
+		return ret;
+
+	if (drvdata->num_profiles) {
+		ret = _si5351_profile_apply(drvdata, 0);
+		if (ret) {
+			dev_err(&client->dev, "failed to write profile\n");
+			return ret;
+		}
+	}
+
+	/*
+	 * Runtime PM has to be enabled before the clocks are registered,
+	 * the clk framework only handles it for providers that have it
+	 * enabled at registration time.
+	 */
+	pm_runtime_set_active(&client->dev);
+	pm_runtime_set_autosuspend_delay(&client->dev,
+					 SI5351_AUTOSUSPEND_DELAY_MS);
+	pm_runtime_use_autosuspend(&client->dev);
+	ret = devm_pm_runtime_enable(&client->dev);
+	if (ret)
+		return ret;
+
 	/* register xtal input clock gate */
 	memset(&init, 0, sizeof(init));
 	init.name = si5351_input_names[0];
@@ -1596,7 +3300,7 @@ static int si5351_i2c_probe(struct i2c_client *client)
 	memset(&init, 0, sizeof(init));
 	init.name = si5351_pll_names[0];
 	init.ops = &si5351_pll_ops;
-	init.flags = 0;
+	init.flags = drvdata->num_profiles ? CLK_GET_RATE_NOCACHE : 0;
 	init.parent_names = parent_names;
 	init.num_parents = num_parents;
 	ret = devm_clk_hw_register(&client->dev, &drvdata->pll[0].hw);
@@ -1611,15 +3315,16 @@ static int si5351_i2c_probe(struct i2c_client *client)
 	drvdata->pll[1].hw.init = &init;
 	memset(&init, 0, sizeof(init));
 	if (drvdata->variant == SI5351_VARIANT_B) {
+		/* the VCXO always runs off the xtal */
 		init.name = si5351_pll_names[2];
 		init.ops = &si5351_vxco_ops;
-		init.flags = 0;
-		init.parent_names = NULL;
-		init.num_parents = 0;
+		init.flags = drvdata->num_profiles ? CLK_GET_RATE_NOCACHE : 0;
+		init.parent_names = parent_names;
+		init.num_parents = 1;
 	} else {
 		init.name = si5351_pll_names[1];
 		init.ops = &si5351_pll_ops;
-		init.flags = 0;
+		init.flags = drvdata->num_profiles ? CLK_GET_RATE_NOCACHE : 0;
 		init.parent_names = parent_names;
 		init.num_parents = num_parents;
 	}
@@ -1695,17 +3400,13 @@ static int si5351_i2c_probe(struct i2c_client *client)
 				init.name);
 			return ret;
 		}
+	}
 
-		/* set initial clkout rate */
-		if (pdata->clkout[n].rate != 0) {
-			int ret;
-			ret = clk_set_rate(drvdata->clkout[n].hw.clk,
-					   pdata->clkout[n].rate);
-			if (ret != 0) {
-				dev_err(&client->dev, "Cannot set rate : %d\n",
-					ret);
-			}
-		}
+	/* set initial clkout rates, unless a profile did already */
+	if (!drvdata->num_profiles) {
+		ret = si5351_set_initial_rates(drvdata, pdata);
+		if (ret)
+			return ret;
 	}
 
 	ret = devm_of_clk_add_hw_provider(&client->dev, si53351_of_clk_get,
@@ -1715,6 +3416,23 @@ static int si5351_i2c_probe(struct i2c_client *client)
 		return ret;
 	}
 
+	BLOCKING_INIT_NOTIFIER_HEAD(&drvdata->notifier);
+	mutex_lock(&si5351_instances_lock);
+	list_add(&drvdata->node, &si5351_instances);
+	mutex_unlock(&si5351_instances_lock);
+	ret = devm_add_action_or_reset(&client->dev, si5351_instance_remove,
+				       drvdata);
+	if (ret)
+		return ret;
+
+	ret = si5351_monitor_init(drvdata);
+	if (ret)
+		return ret;
+
+	ret = si5351_debugfs_init(drvdata);
+	if (ret)
+		return ret;
+
 	return 0;
 }
 
@@ -1722,12 +3440,17 @@ static struct i2c_driver si5351_driver = {
 	.driver = {
 		.name = "si5351",
 		.of_match_table = of_match_ptr(si5351_dt_ids),
+		.pm = pm_ptr(&si5351_pm_ops),
 	},
 	.probe = si5351_i2c_probe,
 	.id_table = si5351_i2c_ids,
 };
 module_i2c_driver(si5351_driver);
 
+#ifdef SI5351_KUNIT_TEST
+#include "clk-si5351_test.c"
+#endif
+
 MODULE_AUTHOR("Sebastian Hesselbarth <sebastian.hesselbarth@gmail.com");
 MODULE_DESCRIPTION("Silicon Labs Si5351A/B/C clock generator driver");
 MODULE_LICENSE("GPL");
@@ -10,6 +10,7 @@
 #define _CLK_SI5351_H_
 
 #define SI5351_BUS_BASE_ADDR			0x60
+#define SI5351_MAX_REGISTER			187
 
 #define SI5351_PLL_VCO_MIN			600000000
 #define SI5351_PLL_VCO_MAX			900000000
@@ -126,6 +127,10 @@
 #define SI5351_VXCO_PARAMETERS_LOW		162
 #define SI5351_VXCO_PARAMETERS_MID		163
 #define SI5351_VXCO_PARAMETERS_HIGH		164
+#define  SI5351_VXCO_PARAM_MAX			((1 << 22) - 1)
+#define  SI5351_VXCO_DENOM			1000000
+#define  SI5351_VXCO_APR_MIN			30
+#define  SI5351_VXCO_APR_MAX			240
 
 #define SI5351_CLK0_PHASE_OFFSET		165
 #define SI5351_CLK1_PHASE_OFFSET		166
@@ -133,6 +138,7 @@
 #define SI5351_CLK3_PHASE_OFFSET		168
 #define SI5351_CLK4_PHASE_OFFSET		169
 #define SI5351_CLK5_PHASE_OFFSET		170
+#define  SI5351_CLK_PHOFF_MAX			0x7f
 
 #define SI5351_PLL_RESET			177
 #define  SI5351_PLL_RESET_B			(1<<7)
@@ -163,4 +169,25 @@ enum si5351_variant {
 	SI5351_VARIANT_C = 4,
 };
 
+struct clk;
+struct device;
+struct notifier_block;
+
+int si5351_clk_register_notifier(struct clk *clk, struct notifier_block *nb);
+int si5351_clk_unregister_notifier(struct clk *clk, struct notifier_block *nb);
+int si5351_clk_get_status(struct clk *clk);
+int si5351_clk_set_phase_ps(struct clk *clk, u32 ps);
+int si5351_clk_oeb_hold(struct clk *clk, bool hold);
+int si5351_clk_claim(struct clk *clk, struct device *owner);
+void si5351_clk_release(struct clk *clk, struct device *owner);
+int si5351_clk_apply_profile(struct clk *clk, unsigned int index);
+
+/* PLL trim, fractional denominator and range */
+#define SI5351_TRIM_DENOM		1000000
+#define SI5351_TRIM_MAX_PPB		1000000
+
+int si5351_clk_set_trim(struct clk *clk, int ppb);
+int si5351_clk_get_trim(struct clk *clk, int *ppb);
+int si5351_clk_trim_check(struct clk *clk, struct clk *ref);
+
 #endif
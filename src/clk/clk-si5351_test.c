@@ -0,0 +1,798 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * KUnit tests for clk-si5351, included by clk-si5351.c when built with
+ * KUNIT=1, so the static helpers can be reached
+ *
+ * The first suite checks the parameter math and the rate solvers against
+ * the audio clock plans. The second one runs the register helpers on a
+ * regmap over a fake register file, which counts the transfers the way
+ * i2c_stats does on the real bus, and holds each register sequence of the
+ * stream lifecycle to its exact transfer count. Both time their helpers
+ * and log the results in ns per call.
+ */
+
+#include <kunit/device.h>
+#include <kunit/test.h>
+
+#define SI5351_TEST_MCLK_24	24576000
+#define SI5351_TEST_MCLK_22	22579200
+
+static const unsigned long si5351_test_xtal[] = { 25000000, 27000000 };
+static const unsigned long si5351_test_mclk[] = {
+	SI5351_TEST_MCLK_22, SI5351_TEST_MCLK_24,
+};
+
+static void si5351_test_encode_integer(struct kunit *test)
+{
+	struct si5351_parameters params;
+
+	si5351_params_encode(&params, 36, 0, 1);
+	KUNIT_EXPECT_EQ(test, params.p1, 36 * 128 - 512);
+	KUNIT_EXPECT_EQ(test, params.p2, 0);
+	KUNIT_EXPECT_EQ(test, params.p3, 1);
+}
+
+static void si5351_test_encode_identity(struct kunit *test)
+{
+	static const unsigned long c[] = { 1, 2, 3, 125, 15625, 1048575 };
+	struct si5351_parameters params;
+	unsigned long a, b;
+	unsigned int n;
+
+	/* P1*P3 + 512*P3 + P2 = 128 * (a*c + b) for every a + b/c */
+	for (a = SI5351_PLL_A_MIN; a <= SI5351_PLL_A_MAX; a++) {
+		for (n = 0; n < ARRAY_SIZE(c); n++) {
+			for (b = 0; b < c[n]; b += c[n] / 7 + 1) {
+				si5351_params_encode(&params, a, b, c[n]);
+				KUNIT_EXPECT_EQ(test,
+					(u64)params.p1 * params.p3 +
+					512 * params.p3 + params.p2,
+					128 * ((u64)a * c[n] + b));
+				KUNIT_EXPECT_LT(test, params.p2, params.p3);
+			}
+		}
+	}
+}
+
+/*
+ * Outputs driving the master clock: the multisynth sets its PLL to the
+ * largest integer multiple of the output within the VCO range, and the
+ * PLL has to hit it exactly from either crystal.
+ */
+static void si5351_test_mclk_plans(struct kunit *test)
+{
+	struct si5351_parameters pll, ms;
+	unsigned long vco, rate;
+	unsigned int x, m;
+	int divby4;
+
+	for (x = 0; x < ARRAY_SIZE(si5351_test_xtal); x++) {
+		for (m = 0; m < ARRAY_SIZE(si5351_test_mclk); m++) {
+			rate = si5351_msynth_calc(&ms, &divby4, 0,
+						  si5351_test_mclk[m], &vco,
+						  true);
+			KUNIT_EXPECT_EQ(test, rate, si5351_test_mclk[m]);
+			KUNIT_EXPECT_EQ(test, divby4, 0);
+			KUNIT_EXPECT_EQ(test, ms.p2, 0);
+			KUNIT_EXPECT_GE(test, vco, SI5351_PLL_VCO_MIN);
+			KUNIT_EXPECT_LE(test, vco, SI5351_PLL_VCO_MAX);
+
+			KUNIT_EXPECT_EQ(test,
+				si5351_pll_calc(&pll, vco, si5351_test_xtal[x]),
+				vco);
+			KUNIT_EXPECT_EQ(test,
+				si5351_pll_rate(&pll, si5351_test_xtal[x]),
+				vco);
+			KUNIT_EXPECT_EQ(test,
+				si5351_msynth_rate(&ms, 0, false, vco),
+				si5351_test_mclk[m]);
+			KUNIT_EXPECT_EQ(test,
+				si5351_rdiv_closest(si5351_test_mclk[m], rate),
+				SI5351_OUTPUT_CLK_DIV_1);
+		}
+	}
+}
+
+/*
+ * I2S clocks, as set up by the card: the PLL runs at 31 times CLKIN, the
+ * multisynth at CLKIN / 8, and the R divider brings it down to LRCLK.
+ */
+static void si5351_test_i2s_plans(struct kunit *test)
+{
+	static const unsigned int fs[] = { 1, 2, 4 };
+	struct si5351_parameters pll, ms;
+	unsigned long clkin, vco, ms_rate, lrclk;
+	unsigned int m, n;
+	int divby4;
+	u8 rdiv;
+
+	for (m = 0; m < ARRAY_SIZE(si5351_test_mclk); m++) {
+		clkin = si5351_test_mclk[m];
+
+		vco = si5351_pll_calc(&pll, 31 * clkin, clkin);
+		KUNIT_EXPECT_EQ(test, vco, 31 * clkin);
+		KUNIT_EXPECT_EQ(test, pll.p2, 0);
+
+		ms_rate = si5351_msynth_calc(&ms, &divby4, 0, clkin / 8, &vco,
+					     false);
+		KUNIT_EXPECT_EQ(test, ms_rate, clkin / 8);
+		KUNIT_EXPECT_EQ(test, ms.p2, 0);
+
+		for (n = 0; n < ARRAY_SIZE(fs); n++) {
+			/* 44.1k/48k, 88.2k/96k, 176.4k/192k */
+			lrclk = clkin / 512 * fs[n];
+			rdiv = si5351_rdiv_closest(lrclk, ms_rate);
+			KUNIT_EXPECT_EQ(test, ms_rate >> rdiv, lrclk);
+		}
+	}
+}
+
+/* a PLL off its integer VCO rate, the divider is fractional */
+static void si5351_test_msynth_fractional(struct kunit *test)
+{
+	struct si5351_parameters ms;
+	unsigned long vco = 25000000 * 31;
+	unsigned long rate;
+	unsigned int m;
+	int divby4;
+
+	for (m = 0; m < ARRAY_SIZE(si5351_test_mclk); m++) {
+		rate = si5351_msynth_calc(&ms, &divby4, 2, si5351_test_mclk[m],
+					  &vco, false);
+		KUNIT_EXPECT_NE(test, ms.p2, 0);
+		KUNIT_EXPECT_LE(test, abs_diff(rate, si5351_test_mclk[m]), 2);
+		KUNIT_EXPECT_EQ(test, si5351_msynth_rate(&ms, 2, false, vco),
+				rate);
+	}
+}
+
+static void si5351_test_msynth_limits(struct kunit *test)
+{
+	struct si5351_parameters ms;
+	unsigned long vco, rate;
+	int divby4;
+
+	/* above 150 MHz only divide by 4 is possible */
+	rate = si5351_msynth_calc(&ms, &divby4, 0, 160000000, &vco, true);
+	KUNIT_EXPECT_EQ(test, divby4, 1);
+	KUNIT_EXPECT_EQ(test, vco, 640000000);
+	KUNIT_EXPECT_EQ(test, rate, 160000000);
+	KUNIT_EXPECT_EQ(test, si5351_msynth_rate(&ms, 0, true, vco), rate);
+
+	/* without setting the PLL, divby4 is not used */
+	vco = 900000000;
+	rate = si5351_msynth_calc(&ms, &divby4, 0, 160000000, &vco, false);
+	KUNIT_EXPECT_EQ(test, divby4, 0);
+	KUNIT_EXPECT_EQ(test, rate, SI5351_MULTISYNTH_DIVBY4_FREQ);
+
+	/* multisynth6-7 divide by the closest integer */
+	vco = 800000000;
+	rate = si5351_msynth_calc(&ms, &divby4, 6, 11000000, &vco, false);
+	KUNIT_EXPECT_EQ(test, ms.p1, 73);
+	KUNIT_EXPECT_EQ(test, rate, vco / 73);
+	KUNIT_EXPECT_EQ(test, si5351_msynth_rate(&ms, 6, false, vco), rate);
+
+	rate = si5351_msynth_calc(&ms, &divby4, 7, 1000000, &vco, false);
+	KUNIT_EXPECT_EQ(test, ms.p1, SI5351_MULTISYNTH67_A_MAX);
+}
+
+/* the returned rate is the one the encoded parameters give */
+static void si5351_test_pll_consistency(struct kunit *test)
+{
+	struct si5351_parameters pll;
+	unsigned long parent, rate, vco;
+
+	for (parent = 10000000; parent <= 100000000; parent += 3333333) {
+		for (rate = 500000000; rate <= 1000000000; rate += 7777777) {
+			vco = si5351_pll_calc(&pll, rate, parent);
+			KUNIT_EXPECT_EQ(test, si5351_pll_rate(&pll, parent),
+					vco);
+			KUNIT_EXPECT_LE(test, vco, SI5351_PLL_A_MAX * parent);
+			KUNIT_EXPECT_GE(test, vco, SI5351_PLL_A_MIN * parent);
+		}
+	}
+}
+
+static void si5351_test_rdiv(struct kunit *test)
+{
+	unsigned long rate;
+	u8 n;
+
+	for (n = SI5351_OUTPUT_CLK_DIV_1; n <= SI5351_OUTPUT_CLK_DIV_128; n++)
+		KUNIT_EXPECT_EQ(test,
+			si5351_rdiv_closest(24576000 >> n, 24576000), n);
+
+	/* closest, also when that is the lower rate */
+	KUNIT_EXPECT_EQ(test, si5351_rdiv_closest(1100000, 4000000), 2);
+	KUNIT_EXPECT_EQ(test, si5351_rdiv_closest(1000, 4000000),
+			SI5351_OUTPUT_CLK_DIV_128);
+
+	rate = 8000;
+	KUNIT_EXPECT_EQ(test, si5351_rdiv_raise(&rate),
+			SI5351_OUTPUT_CLK_DIV_128);
+	KUNIT_EXPECT_EQ(test, rate, 8000 * 128);
+
+	rate = 256000;
+	KUNIT_EXPECT_EQ(test, si5351_rdiv_raise(&rate), 2);
+	KUNIT_EXPECT_EQ(test, rate, 1024000);
+
+	rate = SI5351_MULTISYNTH_MIN_FREQ;
+	KUNIT_EXPECT_EQ(test, si5351_rdiv_raise(&rate),
+			SI5351_OUTPUT_CLK_DIV_1);
+}
+
+static void si5351_test_pack_layout(struct kunit *test)
+{
+	static const u8 expected[SI5351_PARAMETERS_LENGTH] = {
+		0x56, 0x78, 0x02, 0xab, 0xcd, 0xef, 0x12, 0x34,
+	};
+	struct si5351_parameters params = {
+		.p1 = 0x2abcd,
+		.p2 = 0xf1234,
+		.p3 = 0xe5678,
+	};
+	u8 buf[SI5351_PARAMETERS_LENGTH];
+
+	si5351_params_pack(&params, buf);
+	KUNIT_EXPECT_MEMEQ(test, buf, expected, sizeof(buf));
+}
+
+static void si5351_test_pack_round_trip(struct kunit *test)
+{
+	static const unsigned long vals[] = {
+		0, 1, 0xff, 0x100, 0xffff, 0x10000, 0x3ffff, 0xfffff,
+	};
+	struct si5351_parameters in, out;
+	u8 buf[SI5351_PARAMETERS_LENGTH];
+	unsigned int i, j, k;
+
+	for (i = 0; i < ARRAY_SIZE(vals); i++) {
+		for (j = 0; j < ARRAY_SIZE(vals); j++) {
+			for (k = 0; k < ARRAY_SIZE(vals); k++) {
+				/* P1 is 18 bits wide, P2 and P3 are 20 */
+				in.p1 = vals[i] & 0x3ffff;
+				in.p2 = vals[j];
+				in.p3 = vals[k];
+
+				si5351_params_pack(&in, buf);
+				KUNIT_EXPECT_EQ(test, buf[2] & 0xfc, 0);
+
+				si5351_params_unpack(buf, &out);
+				KUNIT_EXPECT_EQ(test, out.p1, in.p1);
+				KUNIT_EXPECT_EQ(test, out.p2, in.p2);
+				KUNIT_EXPECT_EQ(test, out.p3, in.p3);
+				KUNIT_EXPECT_EQ(test, out.valid, 1);
+			}
+		}
+	}
+}
+
+static void si5351_test_encode_round_trip(struct kunit *test)
+{
+	struct si5351_parameters in, out;
+	u8 buf[SI5351_PARAMETERS_LENGTH];
+	unsigned long a;
+
+	for (a = SI5351_MULTISYNTH_A_MIN; a <= SI5351_MULTISYNTH_A_MAX; a++) {
+		si5351_params_encode(&in, a, a % 1000, 1000);
+		si5351_params_pack(&in, buf);
+		si5351_params_unpack(buf, &out);
+		KUNIT_EXPECT_EQ(test, out.p1, in.p1);
+		KUNIT_EXPECT_EQ(test, out.p2, in.p2);
+		KUNIT_EXPECT_EQ(test, out.p3, in.p3);
+	}
+}
+
+#define SI5351_TEST_BENCH_LOOPS	100000
+
+static void si5351_test_bench_log(struct kunit *test, const char *name,
+				  u64 ns, unsigned int loops)
+{
+	kunit_info(test, "%-28s %8llu ns/op\n", name, div_u64(ns, loops));
+}
+
+static void si5351_test_bench_solvers(struct kunit *test)
+{
+	struct si5351_parameters params;
+	u8 buf[SI5351_PARAMETERS_LENGTH];
+	unsigned long vco = 25000000 * 31;
+	unsigned long rate;
+	unsigned int i;
+	int divby4;
+	u64 t;
+
+	t = ktime_get_ns();
+	for (i = 0; i < SI5351_TEST_BENCH_LOOPS; i++) {
+		rate = si5351_pll_calc(&params, 880588800 + i, 25000000);
+		OPTIMIZER_HIDE_VAR(rate);
+	}
+	si5351_test_bench_log(test, "si5351_pll_calc", ktime_get_ns() - t,
+			      SI5351_TEST_BENCH_LOOPS);
+
+	t = ktime_get_ns();
+	for (i = 0; i < SI5351_TEST_BENCH_LOOPS; i++) {
+		rate = si5351_msynth_calc(&params, &divby4, 0, 22579200 + i,
+					  &vco, false);
+		OPTIMIZER_HIDE_VAR(rate);
+	}
+	si5351_test_bench_log(test, "si5351_msynth_calc", ktime_get_ns() - t,
+			      SI5351_TEST_BENCH_LOOPS);
+
+	t = ktime_get_ns();
+	for (i = 0; i < SI5351_TEST_BENCH_LOOPS; i++) {
+		rate = si5351_rdiv_closest(44100 + (i & 0xff), 2822400);
+		OPTIMIZER_HIDE_VAR(rate);
+	}
+	si5351_test_bench_log(test, "si5351_rdiv_closest", ktime_get_ns() - t,
+			      SI5351_TEST_BENCH_LOOPS);
+
+	t = ktime_get_ns();
+	for (i = 0; i < SI5351_TEST_BENCH_LOOPS; i++) {
+		si5351_params_encode(&params, 35, i % 15625, 15625);
+		si5351_params_pack(&params, buf);
+		OPTIMIZER_HIDE_VAR(buf[4]);
+	}
+	si5351_test_bench_log(test, "si5351_params_encode+pack",
+			      ktime_get_ns() - t, SI5351_TEST_BENCH_LOOPS);
+}
+
+static struct kunit_case si5351_test_cases[] = {
+	KUNIT_CASE(si5351_test_encode_integer),
+	KUNIT_CASE(si5351_test_encode_identity),
+	KUNIT_CASE(si5351_test_mclk_plans),
+	KUNIT_CASE(si5351_test_i2s_plans),
+	KUNIT_CASE(si5351_test_msynth_fractional),
+	KUNIT_CASE(si5351_test_msynth_limits),
+	KUNIT_CASE(si5351_test_pll_consistency),
+	KUNIT_CASE(si5351_test_rdiv),
+	KUNIT_CASE(si5351_test_pack_layout),
+	KUNIT_CASE(si5351_test_pack_round_trip),
+	KUNIT_CASE(si5351_test_encode_round_trip),
+	KUNIT_CASE(si5351_test_bench_solvers),
+	{}
+};
+
+static struct kunit_suite si5351_test_suite = {
+	.name = "clk-si5351",
+	.test_cases = si5351_test_cases,
+};
+
+/*
+ * Register file behind a regmap bus. PLL resets clear themselves, the
+ * status reads as locked and written sticky bits read back as cleared,
+ * so the settle polls are done after one read. Transfers are counted
+ * like i2c_stats counts them.
+ */
+struct si5351_test_bus {
+	struct taudac_regmap_stats stats;
+	struct taudac_regmap_counters counters;
+	u8 regs[SI5351_NUM_REGS];
+};
+
+struct si5351_test_ctx {
+	struct si5351_driver_data *drvdata;
+	struct si5351_test_bus *bus;
+};
+
+static int si5351_test_bus_write(void *context, const void *data,
+				 size_t count)
+{
+	struct si5351_test_bus *bus = context;
+	const u8 *buf = data;
+	unsigned int reg = buf[0];
+	size_t n;
+
+	if (reg + count - 1 > SI5351_NUM_REGS)
+		return -EINVAL;
+
+	for (n = 1; n < count; n++, reg++) {
+		switch (reg) {
+		case SI5351_INTERRUPT_STATUS:
+		case SI5351_PLL_RESET:
+			bus->regs[reg] = 0;
+			break;
+		default:
+			bus->regs[reg] = buf[n];
+		}
+	}
+
+	taudac_regmap_account(&bus->stats, buf[0], true, count, count - 1, 0);
+
+	return 0;
+}
+
+static int si5351_test_bus_read(void *context, const void *reg,
+				size_t reg_size, void *val, size_t val_size)
+{
+	struct si5351_test_bus *bus = context;
+	unsigned int r = *(const u8 *)reg;
+
+	if (r + val_size > SI5351_NUM_REGS)
+		return -EINVAL;
+
+	memcpy(val, &bus->regs[r], val_size);
+	taudac_regmap_account(&bus->stats, r, false, reg_size + val_size,
+			      val_size, 0);
+
+	return 0;
+}
+
+static const struct regmap_bus si5351_test_regmap_bus = {
+	.write = si5351_test_bus_write,
+	.read = si5351_test_bus_read,
+};
+
+static void si5351_test_bus_reset(struct si5351_test_bus *bus)
+{
+	memset(&bus->counters, 0, sizeof(bus->counters));
+}
+
+static int si5351_test_bus_init(struct kunit *test)
+{
+	struct si5351_driver_data *drvdata;
+	struct si5351_test_ctx *ctx;
+	struct si5351_test_bus *bus;
+	struct i2c_client *client;
+	struct device *dev;
+	unsigned int reg, val;
+	int n, ret;
+
+	dev = kunit_device_register(test, "si5351-kunit");
+	if (IS_ERR(dev))
+		return PTR_ERR(dev);
+
+	ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	bus = kunit_kzalloc(test, sizeof(*bus), GFP_KERNEL);
+	client = kunit_kzalloc(test, sizeof(*client), GFP_KERNEL);
+	drvdata = kunit_kzalloc(test, sizeof(*drvdata), GFP_KERNEL);
+	if (!ctx || !bus || !client || !drvdata)
+		return -ENOMEM;
+
+	drvdata->msynth = kunit_kcalloc(test, 8, sizeof(*drvdata->msynth),
+					GFP_KERNEL);
+	drvdata->clkout = kunit_kcalloc(test, 8, sizeof(*drvdata->clkout),
+					GFP_KERNEL);
+	if (!drvdata->msynth || !drvdata->clkout)
+		return -ENOMEM;
+
+	spin_lock_init(&bus->stats.lock);
+	bus->stats.reg_bits = si5351_regmap_config.reg_bits;
+	bus->stats.val_bytes = 1;
+	bus->stats.counters = &bus->counters;
+
+	client->dev.init_name = "si5351-kunit";
+	drvdata->client = client;
+	drvdata->variant = SI5351_VARIANT_A;
+	drvdata->num_clkout = 8;
+	mutex_init(&drvdata->phase_lock);
+	mutex_init(&drvdata->trim_lock);
+
+	for (n = 0; n < 2; n++) {
+		drvdata->pll[n].num = n;
+		drvdata->pll[n].drvdata = drvdata;
+	}
+	for (n = 0; n < 8; n++) {
+		drvdata->msynth[n].num = n;
+		drvdata->msynth[n].drvdata = drvdata;
+		drvdata->clkout[n].num = n;
+		drvdata->clkout[n].drvdata = drvdata;
+	}
+
+	drvdata->regmap = devm_regmap_init(dev, &si5351_test_regmap_bus, bus,
+					   &si5351_regmap_config);
+	if (IS_ERR(drvdata->regmap))
+		return PTR_ERR(drvdata->regmap);
+
+	/* fill the cache, as the driver has it after setting the rates */
+	for (reg = 0; reg <= SI5351_MAX_REGISTER; reg++) {
+		ret = regmap_read(drvdata->regmap, reg, &val);
+		if (ret)
+			return ret;
+	}
+	si5351_test_bus_reset(bus);
+
+	ctx->drvdata = drvdata;
+	ctx->bus = bus;
+	test->priv = ctx;
+
+	return 0;
+}
+
+static void si5351_test_params_regmap(struct kunit *test)
+{
+	struct si5351_test_ctx *ctx = test->priv;
+	struct si5351_driver_data *drvdata = ctx->drvdata;
+	struct si5351_parameters in, out;
+	u8 buf[SI5351_PARAMETERS_LENGTH];
+	u8 reg;
+	int n;
+
+	for (n = -2; n < 6; n++) {
+		reg = n < 0 ? (n == -2 ? SI5351_PLLA_PARAMETERS :
+				       SI5351_PLLB_PARAMETERS) :
+			      si5351_msynth_params_address(n);
+
+		/* R divider and divby4 share the block and are kept */
+		regmap_write(drvdata->regmap, reg + 2,
+			     SI5351_OUTPUT_CLK_DIV_MASK |
+			     SI5351_OUTPUT_CLK_DIVBY4);
+
+		si5351_params_encode(&in, 35 + n, 14084, 15625 + n);
+		si5351_write_parameters(drvdata, reg, &in);
+
+		si5351_params_pack(&in, buf);
+		buf[2] |= SI5351_OUTPUT_CLK_DIV_MASK |
+			  SI5351_OUTPUT_CLK_DIVBY4;
+		KUNIT_EXPECT_MEMEQ(test, &ctx->bus->regs[reg], buf,
+				   sizeof(buf));
+
+		si5351_read_parameters(drvdata, reg, &out);
+		KUNIT_EXPECT_EQ(test, out.p1, in.p1);
+		KUNIT_EXPECT_EQ(test, out.p2, in.p2);
+		KUNIT_EXPECT_EQ(test, out.p3, in.p3);
+		KUNIT_EXPECT_EQ(test, out.valid, 1);
+	}
+
+	/* multisynth6-7 take the integer divider only */
+	for (reg = SI5351_CLK6_PARAMETERS; reg <= SI5351_CLK7_PARAMETERS;
+	     reg++) {
+		in.p1 = 0x80 + reg;
+		in.p2 = 0;
+		in.p3 = 0;
+		si5351_write_parameters(drvdata, reg, &in);
+		KUNIT_EXPECT_EQ(test, ctx->bus->regs[reg], in.p1);
+
+		si5351_read_parameters(drvdata, reg, &out);
+		KUNIT_EXPECT_EQ(test, out.p1, in.p1);
+		KUNIT_EXPECT_EQ(test, out.p2, 0);
+		KUNIT_EXPECT_EQ(test, out.p3, 1);
+	}
+}
+
+/* the retune leaves the new divider and R divider in one block */
+static void si5351_test_retune_regmap(struct kunit *test)
+{
+	struct si5351_test_ctx *ctx = test->priv;
+	struct si5351_driver_data *drvdata = ctx->drvdata;
+	struct si5351_hw_data *ms = &drvdata->msynth[1];
+	u8 reg = si5351_msynth_params_address(1);
+	u8 buf[SI5351_PARAMETERS_LENGTH];
+	unsigned long vco = 25000000 * 31;
+	int divby4;
+
+	si5351_msynth_calc(&ms->params, &divby4, 1, SI5351_TEST_MCLK_22,
+			   &vco, false);
+	ms->divby4 = divby4;
+	ms->params_pending = true;
+
+	_si5351_clkout_retune(&drvdata->clkout[1], 3);
+
+	si5351_params_pack(&ms->params, buf);
+	buf[2] |= 3 << SI5351_OUTPUT_CLK_DIV_SHIFT;
+	KUNIT_EXPECT_MEMEQ(test, &ctx->bus->regs[reg], buf, sizeof(buf));
+	KUNIT_EXPECT_FALSE(test, ms->params_pending);
+
+	/* fractional divider, the output runs again */
+	KUNIT_EXPECT_EQ(test, ctx->bus->regs[SI5351_CLK0_CTRL + 1] &
+			SI5351_CLK_INTEGER_MODE, 0);
+	KUNIT_EXPECT_EQ(test, ctx->bus->regs[SI5351_OUTPUT_ENABLE_CTRL] &
+			BIT(1), 0);
+}
+
+/*
+ * I2C transfers of the register sequences the stream lifecycle is built
+ * from, with the register cache filled as it is after probe. A burst is
+ * one write, a read of a volatile register one read.
+ */
+static void si5351_test_expect_bus(struct kunit *test, const char *op,
+				   u64 reads, u64 writes, u64 bytes)
+{
+	struct si5351_test_ctx *ctx = test->priv;
+	struct taudac_regmap_counters *c = &ctx->bus->counters;
+
+	KUNIT_EXPECT_EQ_MSG(test, c->reads, reads, "%s reads", op);
+	KUNIT_EXPECT_EQ_MSG(test, c->writes, writes, "%s writes", op);
+	KUNIT_EXPECT_EQ_MSG(test, c->bytes, bytes, "%s bytes", op);
+	si5351_test_bus_reset(ctx->bus);
+}
+
+static void si5351_test_count_parameters(struct kunit *test)
+{
+	struct si5351_test_ctx *ctx = test->priv;
+	struct si5351_driver_data *drvdata = ctx->drvdata;
+	struct si5351_parameters params;
+
+	si5351_params_encode(&params, 35, 3493, 15625);
+	si5351_write_parameters(drvdata, SI5351_PLLA_PARAMETERS, &params);
+	si5351_test_expect_bus(test, "PLL parameters", 0, 1, 9);
+
+	si5351_read_parameters(drvdata, SI5351_PLLA_PARAMETERS, &params);
+	si5351_test_expect_bus(test, "cached read", 0, 0, 0);
+
+	params.p1 = 8;
+	si5351_write_parameters(drvdata, SI5351_CLK6_PARAMETERS, &params);
+	si5351_test_expect_bus(test, "multisynth6 divider", 0, 1, 2);
+}
+
+static void si5351_test_count_pll_reset(struct kunit *test)
+{
+	struct si5351_test_ctx *ctx = test->priv;
+	struct si5351_driver_data *drvdata = ctx->drvdata;
+	u8 reset = SI5351_PLL_RESET_A | SI5351_PLL_RESET_B;
+
+	/* reset, one status read as the PLLs lock, clear the sticky LOL */
+	_si5351_pll_reset(drvdata, reset);
+	KUNIT_EXPECT_EQ(test, _si5351_pll_settle(drvdata, reset), 0);
+	si5351_test_expect_bus(test, "PLL reset", 1, 2, 6);
+	KUNIT_EXPECT_EQ(test, drvdata->lol_settling, 0);
+
+	/* relock on resume, only for the PLLs feeding a running output */
+	regmap_write(drvdata->regmap, SI5351_CLK0_CTRL,
+		     SI5351_CLK_INPUT_MULTISYNTH_N);
+	regmap_write(drvdata->regmap, SI5351_CLK1_CTRL,
+		     SI5351_CLK_INPUT_MULTISYNTH_N | SI5351_CLK_PLL_SELECT);
+	si5351_test_bus_reset(ctx->bus);
+	KUNIT_EXPECT_EQ(test, _si5351_pll_relock(drvdata), 0);
+	si5351_test_expect_bus(test, "relock", 1, 2, 6);
+
+	regmap_write(drvdata->regmap, SI5351_CLK0_CTRL, SI5351_CLK_POWERDOWN);
+	regmap_write(drvdata->regmap, SI5351_CLK1_CTRL, SI5351_CLK_POWERDOWN);
+	si5351_test_bus_reset(ctx->bus);
+	KUNIT_EXPECT_EQ(test, _si5351_pll_relock(drvdata), 0);
+	si5351_test_expect_bus(test, "relock, PLLs unused", 0, 0, 0);
+}
+
+static void si5351_test_count_retune(struct kunit *test)
+{
+	struct si5351_test_ctx *ctx = test->priv;
+	struct si5351_driver_data *drvdata = ctx->drvdata;
+	struct si5351_hw_data *ms = &drvdata->msynth[2];
+	unsigned long vco = 25000000 * 31;
+	int divby4;
+
+	si5351_msynth_calc(&ms->params, &divby4, 2, SI5351_TEST_MCLK_24,
+			   &vco, false);
+	ms->divby4 = divby4;
+	regmap_write(drvdata->regmap, SI5351_CLK2_CTRL,
+		     SI5351_CLK_INTEGER_MODE);
+	si5351_test_bus_reset(ctx->bus);
+
+	/* hold, leave integer mode, burst, release */
+	ms->params_pending = true;
+	_si5351_clkout_retune(&drvdata->clkout[2], 0);
+	si5351_test_expect_bus(test, "retune to fractional", 0, 4, 15);
+
+	ms->params_pending = true;
+	_si5351_clkout_retune(&drvdata->clkout[2], 1);
+	si5351_test_expect_bus(test, "retune", 0, 3, 13);
+
+	/* a stopped output only needs the burst */
+	regmap_write(drvdata->regmap, SI5351_CLK2_CTRL, SI5351_CLK_POWERDOWN);
+	si5351_test_bus_reset(ctx->bus);
+	ms->params_pending = true;
+	_si5351_clkout_retune(&drvdata->clkout[2], 2);
+	si5351_test_expect_bus(test, "retune, stopped", 0, 1, 9);
+}
+
+static void si5351_test_count_trim(struct kunit *test)
+{
+	struct si5351_test_ctx *ctx = test->priv;
+	struct si5351_driver_data *drvdata = ctx->drvdata;
+	struct si5351_hw_data *pll = &drvdata->pll[0];
+
+	si5351_pll_calc(&drvdata->pll_nominal[0], 800000000, 25000000);
+	drvdata->pll_nominal[0].valid = 1;
+	regmap_write(drvdata->regmap, SI5351_CLK6_CTRL,
+		     SI5351_CLK_INTEGER_MODE);
+	si5351_test_bus_reset(ctx->bus);
+
+	/* leave integer mode, then the burst */
+	KUNIT_EXPECT_EQ(test, _si5351_pll_trim(drvdata, pll, 1000), 0);
+	si5351_test_expect_bus(test, "trim from integer", 0, 2, 11);
+	KUNIT_EXPECT_EQ(test, si5351_pll_rate(&pll->params, 25000000),
+			800000800);
+
+	/* the servo steps: the burst only */
+	KUNIT_EXPECT_EQ(test, _si5351_pll_trim(drvdata, pll, -500), 0);
+	si5351_test_expect_bus(test, "trim step", 0, 1, 9);
+	KUNIT_EXPECT_EQ(test, si5351_pll_rate(&pll->params, 25000000),
+			799999600);
+
+	KUNIT_EXPECT_EQ(test, _si5351_pll_trim(drvdata, pll, 0), 0);
+	si5351_test_expect_bus(test, "trim to integer", 0, 2, 11);
+	KUNIT_EXPECT_EQ(test, si5351_pll_rate(&pll->params, 25000000),
+			800000000);
+}
+
+static void si5351_test_count_profile(struct kunit *test)
+{
+	struct si5351_test_ctx *ctx = test->priv;
+	struct si5351_driver_data *drvdata = ctx->drvdata;
+	struct si5351_profile *profile;
+	unsigned int reg;
+
+	profile = kunit_kzalloc(test, sizeof(*profile), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, profile);
+	drvdata->profiles = profile;
+	drvdata->num_profiles = 1;
+
+	/* clk0 on PLLA through multisynth0; the output enable is skipped */
+	profile->val[SI5351_CLK0_CTRL] = SI5351_CLK_INPUT_MULTISYNTH_N;
+	__set_bit(SI5351_CLK0_CTRL, profile->mask);
+	profile->val[SI5351_OUTPUT_ENABLE_CTRL] = 0xff;
+	__set_bit(SI5351_OUTPUT_ENABLE_CTRL, profile->mask);
+	for (reg = 0; reg < SI5351_PARAMETERS_LENGTH; reg++) {
+		profile->val[SI5351_PLLA_PARAMETERS + reg] = reg + 1;
+		__set_bit(SI5351_PLLA_PARAMETERS + reg, profile->mask);
+		profile->val[SI5351_CLK0_PARAMETERS + reg] = reg + 1;
+		__set_bit(SI5351_CLK0_PARAMETERS + reg, profile->mask);
+	}
+
+	regmap_write(drvdata->regmap, SI5351_CLK0_CTRL, SI5351_CLK_POWERDOWN);
+	si5351_test_bus_reset(ctx->bus);
+
+	/* one write per run of registers, then the PLL reset */
+	KUNIT_EXPECT_EQ(test, _si5351_profile_apply(drvdata, 0), 0);
+	si5351_test_expect_bus(test, "profile", 1, 5, 26);
+
+	/* the output stays powered down as the clk framework left it */
+	KUNIT_EXPECT_EQ(test, ctx->bus->regs[SI5351_CLK0_CTRL],
+			SI5351_CLK_INPUT_MULTISYNTH_N | SI5351_CLK_POWERDOWN);
+	KUNIT_EXPECT_EQ(test, ctx->bus->regs[SI5351_OUTPUT_ENABLE_CTRL], 0);
+}
+
+#define SI5351_TEST_BENCH_BUS_LOOPS	1000
+
+static void si5351_test_bench_regmap(struct kunit *test)
+{
+	struct si5351_test_ctx *ctx = test->priv;
+	struct si5351_driver_data *drvdata = ctx->drvdata;
+	struct si5351_hw_data *ms = &drvdata->msynth[0];
+	struct si5351_parameters params;
+	unsigned long vco = 25000000 * 31;
+	unsigned int i;
+	int divby4;
+	u64 t;
+
+	si5351_msynth_calc(&ms->params, &divby4, 0, SI5351_TEST_MCLK_24,
+			   &vco, false);
+
+	t = ktime_get_ns();
+	for (i = 0; i < SI5351_TEST_BENCH_BUS_LOOPS; i++) {
+		ms->params_pending = true;
+		_si5351_clkout_retune(&drvdata->clkout[0], i & 7);
+	}
+	si5351_test_bench_log(test, "_si5351_clkout_retune",
+			      ktime_get_ns() - t, SI5351_TEST_BENCH_BUS_LOOPS);
+
+	si5351_params_encode(&params, 35, 14084, 15625);
+	t = ktime_get_ns();
+	for (i = 0; i < SI5351_TEST_BENCH_BUS_LOOPS; i++)
+		si5351_write_parameters(drvdata, SI5351_PLLA_PARAMETERS,
+					&params);
+	si5351_test_bench_log(test, "si5351_write_parameters",
+			      ktime_get_ns() - t, SI5351_TEST_BENCH_BUS_LOOPS);
+
+	kunit_info(test, "fake bus: %llu writes, %llu bytes\n",
+		   ctx->bus->counters.writes, ctx->bus->counters.bytes);
+}
+
+static struct kunit_case si5351_test_regmap_cases[] = {
+	KUNIT_CASE(si5351_test_params_regmap),
+	KUNIT_CASE(si5351_test_retune_regmap),
+	KUNIT_CASE(si5351_test_count_parameters),
+	KUNIT_CASE(si5351_test_count_pll_reset),
+	KUNIT_CASE(si5351_test_count_retune),
+	KUNIT_CASE(si5351_test_count_trim),
+	KUNIT_CASE(si5351_test_count_profile),
+	KUNIT_CASE(si5351_test_bench_regmap),
+	{}
+};
+
+static struct kunit_suite si5351_test_regmap_suite = {
+	.name = "clk-si5351-regmap",
+	.init = si5351_test_bus_init,
+	.test_cases = si5351_test_regmap_cases,
+};
+
+kunit_test_suites(&si5351_test_suite, &si5351_test_regmap_suite);
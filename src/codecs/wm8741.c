@@ -12,6 +12,7 @@
 #include <linux/init.h>
 #include <linux/delay.h>
 #include <linux/pm.h>
+#include <linux/pm_runtime.h>
 #include <linux/i2c.h>
 #include <linux/spi/spi.h>
 #include <linux/of.h>
@@ -26,6 +27,14 @@
 #include <sound/tlv.h>
 
 #include "wm8741.h"
+#include "wm8741_volume.h"
+#include "taudac_regmap_stats.h"
+
+#define CREATE_TRACE_POINTS
+#define TAUDAC_TRACE_WM8741
+#include "taudac_trace.h"
+
+#define WM8741_AUTOSUSPEND_DELAY_MS 5000
 
 #define WM8741_NUM_SUPPLIES 2
 static const char *wm8741_supply_names[WM8741_NUM_SUPPLIES] = {
@@ -40,6 +49,7 @@ struct wm8741_priv {
 	struct regulator_bulk_data supplies[WM8741_NUM_SUPPLIES];
 	unsigned int sysclk;
 	const struct snd_pcm_hw_constraint_list *sysclk_constraints;
+	struct taudac_regmap_stats *i2c_stats;
 };
 
 static const struct reg_default wm8741_reg_defaults[] = {
@@ -59,18 +69,13 @@ static unsigned int _wm8741_volume_get(struct snd_soc_component *component,
 		struct soc_mixer_control *mc, unsigned int lsb_reg)
 {
 	unsigned int msb_reg = lsb_reg + 1;
-	unsigned int mask = mc->max;
-	unsigned int val, msb_val, lsb_val;
+	unsigned int msb_val, lsb_val;
 
 	msb_val = snd_soc_component_read(component, msb_reg);
 	lsb_val = snd_soc_component_read(component, lsb_reg);
 
-	val = ((msb_val << mc->shift) | lsb_val) & mask;
-
-	if (mc->invert)
-		val = mc->max - val;
-
-	return val;
+	return wm8741_volume_from_regs(lsb_val, msb_val, mc->max, mc->invert,
+			mc->shift);
 }
 
 static int _wm8741_volume_set(struct snd_soc_component *component,
@@ -78,14 +83,13 @@ static int _wm8741_volume_set(struct snd_soc_component *component,
 		unsigned int val)
 {
 	unsigned int msb_reg = lsb_reg + 1;
-	unsigned int upd = (1 << mc->shift);
-	unsigned int mask = upd - 1;
+	unsigned int msb_val, lsb_val;
 
-	if (mc->invert)
-		val = mc->max - val;
+	wm8741_volume_to_regs(val, mc->max, mc->invert, mc->shift,
+			&lsb_val, &msb_val);
 
-	snd_soc_component_write(component, lsb_reg, val & mask);
-	snd_soc_component_write(component, msb_reg, (val >> mc->shift) | upd);
+	snd_soc_component_write(component, lsb_reg, lsb_val);
+	snd_soc_component_write(component, msb_reg, msb_val);
 
 	return 0;
 }
@@ -312,6 +316,8 @@ static int wm8741_hw_params(struct snd_pcm_substream *substream,
 
 	dev_dbg(component->dev, "wm8741_hw_params:    bit size param = %d, rate param = %d",
 		params_width(params), params_rate(params));
+	trace_wm8741_hw_params(component->dev, params_rate(params),
+			       params_width(params), wm8741->sysclk);
 
 	snd_soc_component_update_bits(component, WM8741_FORMAT_CONTROL, WM8741_IWL_MASK,
 			    iface);
@@ -468,16 +474,6 @@ static struct snd_soc_dai_driver wm8741_dai = {
 	.ops = &wm8741_dai_ops,
 };
 
-#ifdef CONFIG_PM
-static int wm8741_resume(struct snd_soc_component *component)
-{
-	snd_soc_component_cache_sync(component);
-	return 0;
-}
-#else
-#define wm8741_resume NULL
-#endif
-
 static int wm8741_configure(struct snd_soc_component *component)
 {
 	struct wm8741_priv *wm8741 = snd_soc_component_get_drvdata(component);
@@ -567,6 +563,14 @@ static int wm8741_probe(struct snd_soc_component *component)
 		goto err_enable;
 	}
 
+	/* the supplies are released again once the codec is idle */
+	pm_runtime_set_active(component->dev);
+	pm_runtime_set_autosuspend_delay(component->dev,
+					 WM8741_AUTOSUSPEND_DELAY_MS);
+	pm_runtime_use_autosuspend(component->dev);
+	pm_runtime_mark_last_busy(component->dev);
+	pm_runtime_enable(component->dev);
+
 	dev_dbg(component->dev, "Successful registration\n");
 	return ret;
 
@@ -580,13 +584,87 @@ static void wm8741_remove(struct snd_soc_component *component)
 {
 	struct wm8741_priv *wm8741 = snd_soc_component_get_drvdata(component);
 
+	pm_runtime_disable(component->dev);
+	pm_runtime_dont_use_autosuspend(component->dev);
+
+	if (!pm_runtime_status_suspended(component->dev))
+		regulator_bulk_disable(ARRAY_SIZE(wm8741->supplies),
+				       wm8741->supplies);
+	pm_runtime_set_suspended(component->dev);
+}
+
+static int wm8741_runtime_suspend(struct device *dev)
+{
+	struct wm8741_priv *wm8741 = dev_get_drvdata(dev);
+
+	regcache_cache_only(wm8741->regmap, true);
+	regcache_mark_dirty(wm8741->regmap);
+
 	regulator_bulk_disable(ARRAY_SIZE(wm8741->supplies), wm8741->supplies);
+
+	return 0;
+}
+
+static int _wm8741_runtime_resume(struct device *dev)
+{
+	struct wm8741_priv *wm8741 = dev_get_drvdata(dev);
+	int ret;
+
+	ret = regulator_bulk_enable(ARRAY_SIZE(wm8741->supplies),
+				    wm8741->supplies);
+	if (ret != 0) {
+		dev_err(dev, "Failed to enable supplies: %d\n", ret);
+		return ret;
+	}
+
+	/* restore the register image in a single cache sync */
+	regcache_cache_only(wm8741->regmap, false);
+	ret = regcache_sync(wm8741->regmap);
+	if (ret != 0) {
+		dev_err(dev, "Failed to sync cache: %d\n", ret);
+		regcache_cache_only(wm8741->regmap, true);
+		regulator_bulk_disable(ARRAY_SIZE(wm8741->supplies),
+				       wm8741->supplies);
+		return ret;
+	}
+
+	return 0;
+}
+
+static int wm8741_runtime_resume(struct device *dev)
+{
+	u64 t = ktime_get_ns();
+	int ret;
+
+	ret = _wm8741_runtime_resume(dev);
+	trace_wm8741_runtime_resume(dev, ktime_get_ns() - t, ret);
+
+	return ret;
+}
+
+/*
+ * System sleep goes through the runtime PM callbacks: the supplies are
+ * switched off and the register image is restored by a cache sync.
+ */
+static const struct dev_pm_ops wm8741_pm_ops = {
+	SYSTEM_SLEEP_PM_OPS(pm_runtime_force_suspend, pm_runtime_force_resume)
+	RUNTIME_PM_OPS(wm8741_runtime_suspend, wm8741_runtime_resume, NULL)
+};
+
+static void wm8741_debugfs_init(struct snd_soc_component *component,
+				struct dentry *root)
+{
+	struct wm8741_priv *wm8741 = snd_soc_component_get_drvdata(component);
+
+	/* only the I2C regmap is accounted */
+	if (wm8741->i2c_stats)
+		taudac_regmap_stats_debugfs(wm8741->i2c_stats, root);
 }
 
 static const struct snd_soc_component_driver soc_component_dev_wm8741 = {
 	.probe			= wm8741_probe,
 	.remove			= wm8741_remove,
-	.resume			= wm8741_resume,
+	.debugfs_init		= wm8741_debugfs_init,
 	.dapm_widgets		= wm8741_dapm_widgets,
 	.num_dapm_widgets	= ARRAY_SIZE(wm8741_dapm_widgets),
 	.dapm_routes		= wm8741_dapm_routes,
@@ -602,10 +680,23 @@ static const struct of_device_id wm8741_of_match[] = {
 };
 MODULE_DEVICE_TABLE(of, wm8741_of_match);
 
+static bool wm8741_volatile_register(struct device *dev, unsigned int reg)
+{
+	/* never replay a reset on cache sync */
+	return reg == WM8741_RESET;
+}
+
+static const struct taudac_regmap_range wm8741_i2c_ranges[] = {
+	{ "volume", WM8741_DACLLSB_ATTENUATION, WM8741_VOLUME_CONTROL },
+	{ "ctrl",   WM8741_FORMAT_CONTROL,      WM8741_RESET },
+	{ "addctl", WM8741_ADDITIONAL_CONTROL_1, WM8741_ADDITIONAL_CONTROL_1 },
+};
+
 static const struct regmap_config wm8741_regmap = {
 	.reg_bits = 7,
 	.val_bits = 9,
 	.max_register = WM8741_MAX_REGISTER,
+	.volatile_reg = wm8741_volatile_register,
 
 	.reg_defaults = wm8741_reg_defaults,
 	.num_reg_defaults = ARRAY_SIZE(wm8741_reg_defaults),
@@ -650,7 +741,10 @@ static int wm8741_i2c_probe(struct i2c_client *i2c)
 		return ret;
 	}
 
-	wm8741->regmap = devm_regmap_init_i2c(i2c, &wm8741_regmap);
+	wm8741->regmap = devm_taudac_regmap_init_i2c(i2c, &wm8741_regmap,
+					wm8741_i2c_ranges,
+					ARRAY_SIZE(wm8741_i2c_ranges),
+					&wm8741->i2c_stats);
 	if (IS_ERR(wm8741->regmap)) {
 		ret = PTR_ERR(wm8741->regmap);
 		dev_err(&i2c->dev, "Failed to init regmap: %d\n", ret);
@@ -681,6 +775,7 @@ static struct i2c_driver wm8741_i2c_driver = {
 	.driver = {
 		.name = "wm8741",
 		.of_match_table = wm8741_of_match,
+		.pm = pm_ptr(&wm8741_pm_ops),
 	},
 	.probe = wm8741_i2c_probe,
 	.id_table = wm8741_i2c_id,
@@ -732,6 +827,7 @@ static struct spi_driver wm8741_spi_driver = {
 	.driver = {
 		.name	= "wm8741",
 		.of_match_table = wm8741_of_match,
+		.pm	= pm_ptr(&wm8741_pm_ops),
 	},
 	.probe		= wm8741_spi_probe,
 };
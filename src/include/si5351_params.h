@@ -0,0 +1,306 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Si5351 PLL, multisynth and R divider math, shared by clk-si5351 and the
+ * host bench
+ *
+ * Kept free of register access, see AN619 [2] of clk-si5351.c:
+ *
+ * P1 = 128 * a + floor(128 * b/c) - 512
+ * P2 = (128 * b) mod c
+ * P3 = c
+ */
+#ifndef _SI5351_PARAMS_H
+#define _SI5351_PARAMS_H
+
+#include <linux/math.h>
+#include <linux/math64.h>
+#include <linux/rational.h>
+#include <linux/types.h>
+
+#include "clk-si5351.h"
+
+struct si5351_parameters {
+	unsigned long	p1;
+	unsigned long	p2;
+	unsigned long	p3;
+	int		valid;
+};
+
+static inline void si5351_params_encode(struct si5351_parameters *params,
+					unsigned long a, unsigned long b,
+					unsigned long c)
+{
+	params->p3  = c;
+	params->p2  = (128 * b) % c;
+	params->p1  = 128 * a;
+	params->p1 += (128 * b / c);
+	params->p1 -= 512;
+}
+
+/* MSNx/MSx parameter block layout; the R divider and divby4 are left 0 */
+static inline void si5351_params_pack(const struct si5351_parameters *params,
+				      u8 *buf)
+{
+	buf[0] = ((params->p3 & 0x0ff00) >> 8) & 0xff;
+	buf[1] = params->p3 & 0xff;
+	buf[2] = ((params->p1 & 0x30000) >> 16) & 0x03;
+	buf[3] = ((params->p1 & 0x0ff00) >> 8) & 0xff;
+	buf[4] = params->p1 & 0xff;
+	buf[5] = ((params->p3 & 0xf0000) >> 12) |
+		((params->p2 & 0xf0000) >> 16);
+	buf[6] = ((params->p2 & 0x0ff00) >> 8) & 0xff;
+	buf[7] = params->p2 & 0xff;
+}
+
+static inline void si5351_params_unpack(const u8 *buf,
+					struct si5351_parameters *params)
+{
+	params->p1 = ((buf[2] & 0x03) << 16) | (buf[3] << 8) | buf[4];
+	params->p2 = ((buf[5] & 0x0f) << 16) | (buf[6] << 8) | buf[7];
+	params->p3 = ((buf[5] & 0xf0) << 12) | (buf[0] << 8) | buf[1];
+	params->valid = 1;
+}
+
+/* fVCO = fIN * (P1*P3 + 512*P3 + P2)/(128*P3) */
+static inline unsigned long
+si5351_pll_rate(const struct si5351_parameters *params,
+		unsigned long parent_rate)
+{
+	u64 rate;
+
+	if (params->p3 == 0)
+		return parent_rate;
+
+	rate  = (u64)params->p1 * params->p3;
+	rate += 512 * params->p3;
+	rate += params->p2;
+	rate *= parent_rate;
+	do_div(rate, 128 * params->p3);
+
+	return (unsigned long)rate;
+}
+
+/*
+ * multisync0-5: fOUT = (128 * P3 * fIN) / (P1*P3 + P2 + 512*P3)
+ * multisync6-7: fOUT = fIN / P1
+ */
+static inline unsigned long
+si5351_msynth_rate(const struct si5351_parameters *params, unsigned int num,
+		   bool divby4, unsigned long parent_rate)
+{
+	u64 rate = parent_rate;
+	u64 m;
+
+	if (num > 5) {
+		m = params->p1;
+	} else if (params->p3 == 0) {
+		return parent_rate;
+	} else if (divby4) {
+		m = 4;
+	} else {
+		rate *= 128 * params->p3;
+		m  = (u64)params->p1 * params->p3;
+		m += params->p2;
+		m += 512 * params->p3;
+	}
+
+	if (m == 0)
+		return 0;
+
+	return (unsigned long)div64_u64(rate, m);
+}
+
+/*
+ * Feedback divider a + b/c for the VCO rate closest to the one asked for,
+ * with b/c approximated within the register widths. Returns the VCO rate
+ * the parameters give.
+ */
+static inline unsigned long si5351_pll_calc(struct si5351_parameters *params,
+					    unsigned long rate,
+					    unsigned long parent_rate)
+{
+	unsigned long rfrac, denom, a, b, c;
+	u64 lltmp;
+
+	if (rate < SI5351_PLL_VCO_MIN)
+		rate = SI5351_PLL_VCO_MIN;
+	if (rate > SI5351_PLL_VCO_MAX)
+		rate = SI5351_PLL_VCO_MAX;
+
+	/* determine integer part of feedback equation */
+	a = rate / parent_rate;
+	if (a < SI5351_PLL_A_MIN) {
+		a = SI5351_PLL_A_MIN;
+		rate = parent_rate * a;
+	}
+	if (a > SI5351_PLL_A_MAX) {
+		a = SI5351_PLL_A_MAX;
+		rate = parent_rate * a;
+	}
+
+	/* find best approximation for b/c = fVCO mod fIN */
+	denom = 1000 * 1000;
+	lltmp = rate % parent_rate;
+	lltmp *= denom;
+	do_div(lltmp, parent_rate);
+	rfrac = (unsigned long)lltmp;
+
+	b = 0;
+	c = 1;
+	if (rfrac)
+		rational_best_approximation(rfrac, denom,
+				    SI5351_PLL_B_MAX, SI5351_PLL_C_MAX, &b, &c);
+
+	si5351_params_encode(params, a, b, c);
+
+	/* recalculate rate by fIN * (a + b/c) */
+	lltmp  = parent_rate;
+	lltmp *= b;
+	do_div(lltmp, c);
+
+	return (unsigned long)lltmp + parent_rate * a;
+}
+
+/*
+ * Multisynth divider for the output rate closest to the one asked for.
+ * With set_parent, the largest integer divider for the maximum VCO rate
+ * is picked and the PLL rate it needs is returned in parent_rate; else
+ * the divider is fitted to parent_rate. Returns the output rate.
+ */
+static inline unsigned long
+si5351_msynth_calc(struct si5351_parameters *params, int *divby4,
+		   unsigned int num, unsigned long rate,
+		   unsigned long *parent_rate, bool set_parent)
+{
+	unsigned long a, b, c;
+	u64 lltmp;
+
+	/* multisync6-7 can only handle freqencies < 150MHz */
+	if (num >= 6 && rate > SI5351_MULTISYNTH67_MAX_FREQ)
+		rate = SI5351_MULTISYNTH67_MAX_FREQ;
+
+	/* multisync frequency is 1MHz .. 160MHz */
+	if (rate > SI5351_MULTISYNTH_MAX_FREQ)
+		rate = SI5351_MULTISYNTH_MAX_FREQ;
+	if (rate < SI5351_MULTISYNTH_MIN_FREQ)
+		rate = SI5351_MULTISYNTH_MIN_FREQ;
+
+	*divby4 = 0;
+	if (rate > SI5351_MULTISYNTH_DIVBY4_FREQ)
+		*divby4 = 1;
+
+	/* multisync can set pll */
+	if (set_parent) {
+		/*
+		 * find largest integer divider for max
+		 * vco frequency and given target rate
+		 */
+		if (*divby4 == 0) {
+			lltmp = SI5351_PLL_VCO_MAX;
+			do_div(lltmp, rate);
+			a = (unsigned long)lltmp;
+		} else
+			a = 4;
+
+		b = 0;
+		c = 1;
+
+		*parent_rate = a * rate;
+	} else if (num >= 6) {
+		/* determine the closest integer divider */
+		a = DIV_ROUND_CLOSEST(*parent_rate, rate);
+		if (a < SI5351_MULTISYNTH_A_MIN)
+			a = SI5351_MULTISYNTH_A_MIN;
+		if (a > SI5351_MULTISYNTH67_A_MAX)
+			a = SI5351_MULTISYNTH67_A_MAX;
+
+		b = 0;
+		c = 1;
+	} else {
+		unsigned long rfrac, denom;
+
+		/* disable divby4 */
+		if (*divby4) {
+			rate = SI5351_MULTISYNTH_DIVBY4_FREQ;
+			*divby4 = 0;
+		}
+
+		/* determine integer part of divider equation */
+		a = *parent_rate / rate;
+		if (a < SI5351_MULTISYNTH_A_MIN)
+			a = SI5351_MULTISYNTH_A_MIN;
+		if (a > SI5351_MULTISYNTH_A_MAX)
+			a = SI5351_MULTISYNTH_A_MAX;
+
+		/* find best approximation for b/c = fVCO mod fOUT */
+		denom = 1000 * 1000;
+		lltmp = *parent_rate % rate;
+		lltmp *= denom;
+		do_div(lltmp, rate);
+		rfrac = (unsigned long)lltmp;
+
+		b = 0;
+		c = 1;
+		if (rfrac)
+			rational_best_approximation(rfrac, denom,
+			    SI5351_MULTISYNTH_B_MAX, SI5351_MULTISYNTH_C_MAX,
+			    &b, &c);
+	}
+
+	/* calculate parameters */
+	if (*divby4) {
+		params->p3 = 1;
+		params->p2 = 0;
+		params->p1 = 0;
+	} else if (num >= 6) {
+		params->p3 = 0;
+		params->p2 = 0;
+		params->p1 = a;
+	} else {
+		si5351_params_encode(params, a, b, c);
+	}
+
+	/* recalculate rate by fOUT = fIN / (a + b/c) */
+	lltmp  = *parent_rate;
+	lltmp *= c;
+	do_div(lltmp, a * c + b);
+
+	return (unsigned long)lltmp;
+}
+
+/* R divider raising an output rate below 1MHz into the multisynth range */
+static inline unsigned char si5351_rdiv_raise(unsigned long *rate)
+{
+	unsigned char rdiv = SI5351_OUTPUT_CLK_DIV_1;
+
+	while (*rate < SI5351_MULTISYNTH_MIN_FREQ &&
+	       rdiv < SI5351_OUTPUT_CLK_DIV_128) {
+		rdiv += 1;
+		*rate *= 2;
+	}
+
+	return rdiv;
+}
+
+/* R divider giving the output rate closest to the one asked for */
+static inline unsigned char si5351_rdiv_closest(unsigned long rate,
+						unsigned long parent_rate)
+{
+	unsigned char rdiv = SI5351_OUTPUT_CLK_DIV_1;
+	unsigned long new_rate, new_err, err;
+
+	new_rate = parent_rate;
+	err = abs_diff(new_rate, rate);
+	do {
+		new_rate >>= 1;
+		new_err = abs_diff(new_rate, rate);
+		if (new_err > err || rdiv == SI5351_OUTPUT_CLK_DIV_128)
+			break;
+		rdiv++;
+		err = new_err;
+	} while (1);
+
+	return rdiv;
+}
+
+#endif /* _SI5351_PARAMS_H */
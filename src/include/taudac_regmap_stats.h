@@ -0,0 +1,229 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * I2C regmap bus with transaction accounting, shared by the Si5351 and
+ * WM8741 drivers
+ *
+ * Counts reads, writes, bytes, bursts and bus time per register range
+ * and exposes them in debugfs. Writing to "i2c_snapshot" saves the current
+ * counters, "i2c_stats" then also shows the difference to the snapshot, so
+ * the bus cost of a single operation can be measured.
+ */
+#ifndef _TAUDAC_REGMAP_STATS_H
+#define _TAUDAC_REGMAP_STATS_H
+
+#include <linux/debugfs.h>
+#include <linux/device.h>
+#include <linux/i2c.h>
+#include <linux/regmap.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/timekeeping.h>
+
+struct taudac_regmap_range {
+	const char *name;
+	unsigned int min;
+	unsigned int max;
+};
+
+struct taudac_regmap_counters {
+	u64 reads;
+	u64 writes;
+	u64 bytes;
+	u64 bursts;
+	u64 bus_ns;
+};
+
+struct taudac_regmap_stats {
+	struct i2c_client *client;
+	unsigned int reg_bits;
+	unsigned int val_bytes;
+	const struct taudac_regmap_range *ranges;
+	unsigned int num_ranges;
+	spinlock_t lock;
+	/* one more than ranges, for registers outside of them */
+	struct taudac_regmap_counters *counters;
+	struct taudac_regmap_counters *snapshot;
+};
+
+static void taudac_regmap_account(struct taudac_regmap_stats *stats,
+				  unsigned int reg, bool write, size_t bytes,
+				  size_t val_bytes, u64 ns)
+{
+	struct taudac_regmap_counters *c;
+	unsigned long flags;
+	unsigned int n;
+
+	for (n = 0; n < stats->num_ranges; n++)
+		if (reg >= stats->ranges[n].min && reg <= stats->ranges[n].max)
+			break;
+	c = &stats->counters[n];
+
+	spin_lock_irqsave(&stats->lock, flags);
+	if (write)
+		c->writes++;
+	else
+		c->reads++;
+	c->bytes += bytes;
+	if (val_bytes > stats->val_bytes)
+		c->bursts++;
+	c->bus_ns += ns;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
+/* registers up to 8 bits wide lead the first byte on the bus */
+static unsigned int taudac_regmap_reg(struct taudac_regmap_stats *stats,
+				      const u8 *buf)
+{
+	return buf[0] >> (8 - stats->reg_bits);
+}
+
+static int taudac_regmap_i2c_write(void *context, const void *data,
+				   size_t count)
+{
+	struct taudac_regmap_stats *stats = context;
+	u64 t = ktime_get_ns();
+	int ret;
+
+	ret = i2c_master_send(stats->client, data, count);
+	taudac_regmap_account(stats, taudac_regmap_reg(stats, data), true,
+			      count, count - 1, ktime_get_ns() - t);
+
+	if (ret == count)
+		return 0;
+
+	return ret < 0 ? ret : -EIO;
+}
+
+static int taudac_regmap_i2c_read(void *context, const void *reg,
+				  size_t reg_size, void *val, size_t val_size)
+{
+	struct taudac_regmap_stats *stats = context;
+	struct i2c_msg xfer[2] = {
+		{
+			.addr = stats->client->addr,
+			.len = reg_size,
+			.buf = (u8 *)reg,
+		}, {
+			.addr = stats->client->addr,
+			.flags = I2C_M_RD,
+			.len = val_size,
+			.buf = val,
+		},
+	};
+	u64 t = ktime_get_ns();
+	int ret;
+
+	ret = i2c_transfer(stats->client->adapter, xfer, 2);
+	taudac_regmap_account(stats, taudac_regmap_reg(stats, reg), false,
+			      reg_size + val_size, val_size,
+			      ktime_get_ns() - t);
+
+	if (ret == 2)
+		return 0;
+
+	return ret < 0 ? ret : -EIO;
+}
+
+static const struct regmap_bus taudac_regmap_i2c_bus = {
+	.write = taudac_regmap_i2c_write,
+	.read = taudac_regmap_i2c_read,
+};
+
+static struct regmap *
+devm_taudac_regmap_init_i2c(struct i2c_client *client,
+			    const struct regmap_config *config,
+			    const struct taudac_regmap_range *ranges,
+			    unsigned int num_ranges,
+			    struct taudac_regmap_stats **pstats)
+{
+	struct device *dev = &client->dev;
+	struct taudac_regmap_stats *stats;
+
+	if (WARN_ON(config->reg_bits > 8))
+		return ERR_PTR(-EINVAL);
+
+	stats = devm_kzalloc(dev, sizeof(*stats), GFP_KERNEL);
+	if (!stats)
+		return ERR_PTR(-ENOMEM);
+
+	stats->counters = devm_kcalloc(dev, num_ranges + 1,
+				       sizeof(*stats->counters), GFP_KERNEL);
+	stats->snapshot = devm_kcalloc(dev, num_ranges + 1,
+				       sizeof(*stats->snapshot), GFP_KERNEL);
+	if (!stats->counters || !stats->snapshot)
+		return ERR_PTR(-ENOMEM);
+
+	stats->client = client;
+	stats->reg_bits = config->reg_bits;
+	stats->val_bytes = DIV_ROUND_UP(config->val_bits, 8);
+	stats->ranges = ranges;
+	stats->num_ranges = num_ranges;
+	spin_lock_init(&stats->lock);
+	*pstats = stats;
+
+	return devm_regmap_init(dev, &taudac_regmap_i2c_bus, stats, config);
+}
+
+static int taudac_regmap_stats_show(struct seq_file *s, void *data)
+{
+	struct taudac_regmap_stats *stats = s->private;
+	struct taudac_regmap_counters c, d;
+	unsigned int n;
+
+	seq_printf(s, "%-8s %10s %10s %10s %10s %12s  (since snapshot)\n",
+		   "range", "reads", "writes", "bytes", "bursts", "bus_us");
+
+	for (n = 0; n <= stats->num_ranges; n++) {
+		spin_lock_irq(&stats->lock);
+		c = stats->counters[n];
+		d = stats->snapshot[n];
+		spin_unlock_irq(&stats->lock);
+
+		seq_printf(s, "%-8s %10llu %10llu %10llu %10llu %12llu  (%llu %llu %llu %llu %llu)\n",
+			   n < stats->num_ranges ? stats->ranges[n].name :
+						   "other",
+			   c.reads, c.writes, c.bytes, c.bursts,
+			   div_u64(c.bus_ns, NSEC_PER_USEC),
+			   c.reads - d.reads, c.writes - d.writes,
+			   c.bytes - d.bytes, c.bursts - d.bursts,
+			   div_u64(c.bus_ns - d.bus_ns, NSEC_PER_USEC));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(taudac_regmap_stats);
+
+static ssize_t taudac_regmap_snapshot_write(struct file *file,
+					    const char __user *buf,
+					    size_t count, loff_t *ppos)
+{
+	struct taudac_regmap_stats *stats = file->private_data;
+
+	spin_lock_irq(&stats->lock);
+	memcpy(stats->snapshot, stats->counters,
+	       (stats->num_ranges + 1) * sizeof(*stats->counters));
+	spin_unlock_irq(&stats->lock);
+
+	return count;
+}
+
+static const struct file_operations taudac_regmap_snapshot_fops = {
+	.open   = simple_open,
+	.write  = taudac_regmap_snapshot_write,
+	.llseek = noop_llseek,
+};
+
+static void taudac_regmap_stats_debugfs(struct taudac_regmap_stats *stats,
+					struct dentry *parent)
+{
+	if (IS_ERR_OR_NULL(parent))
+		return;
+
+	debugfs_create_file("i2c_stats", 0444, parent, stats,
+			    &taudac_regmap_stats_fops);
+	debugfs_create_file("i2c_snapshot", 0200, parent, stats,
+			    &taudac_regmap_snapshot_fops);
+}
+
+#endif /* _TAUDAC_REGMAP_STATS_H */
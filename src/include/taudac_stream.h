@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * TauDAC stream format decisions, shared by the machine driver and the
+ * host benchmark
+ *
+ * Kept free of any hardware access.
+ */
+#ifndef _TAUDAC_STREAM_H
+#define _TAUDAC_STREAM_H
+
+#include <linux/errno.h>
+#include <sound/soc-dai.h>
+
+/*
+ * Returns the I2S slot width for a sample width, and sets the matching
+ * DAI format.
+ */
+static inline int taudac_stream_fmt(int width, unsigned int *fmt)
+{
+	*fmt = SND_SOC_DAIFMT_I2S | SND_SOC_DAIFMT_BC_FC;
+
+	switch (width) {
+	case 16:
+		*fmt |= SND_SOC_DAIFMT_IB_NF;
+		return 16;
+	case 24:
+	case 32:
+		*fmt |= SND_SOC_DAIFMT_NB_NF;
+		return 32;
+	default:
+		return -EINVAL;
+	}
+}
+
+/* master clock rate of the rate family, 0 if unsupported */
+static inline unsigned int taudac_stream_mclk_rate(unsigned int lrclk_rate)
+{
+	switch (lrclk_rate) {
+	case 44100:
+	case 88200:
+	case 176400:
+		return 22579200;
+	case 32000:
+	case 48000:
+	case 96000:
+	case 192000:
+		return 24576000;
+	default:
+		return 0;
+	}
+}
+
+#endif /* _TAUDAC_STREAM_H */
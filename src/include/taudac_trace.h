@@ -0,0 +1,214 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Trace events for the TauDAC card, the Si5351 clock generator and the
+ * WM8741 codec
+ *
+ * Each module defines its TAUDAC_TRACE_* section before including this
+ * header, so every event is created by exactly one module.
+ */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM taudac
+
+#if !defined(_TAUDAC_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TAUDAC_TRACE_H
+
+#include <linux/device.h>
+#include <linux/tracepoint.h>
+
+#ifdef TAUDAC_TRACE_CARD
+/*
+ * asoc machine driver
+ */
+TRACE_EVENT(taudac_mclk_enable,
+	TP_PROTO(unsigned long rate, u64 settle_ns, int ret),
+	TP_ARGS(rate, settle_ns, ret),
+	TP_STRUCT__entry(
+		__field(unsigned long, rate)
+		__field(u64, settle_ns)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__entry->rate = rate;
+		__entry->settle_ns = settle_ns;
+		__entry->ret = ret;
+	),
+	TP_printk("rate=%lu settle_ns=%llu ret=%d", __entry->rate,
+		  __entry->settle_ns, __entry->ret)
+);
+
+TRACE_EVENT(taudac_i2s_clks_set_rate,
+	TP_PROTO(unsigned long bclk_rate, unsigned long lrclk_rate,
+		 u64 duration_ns, int ret),
+	TP_ARGS(bclk_rate, lrclk_rate, duration_ns, ret),
+	TP_STRUCT__entry(
+		__field(unsigned long, bclk_rate)
+		__field(unsigned long, lrclk_rate)
+		__field(u64, duration_ns)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__entry->bclk_rate = bclk_rate;
+		__entry->lrclk_rate = lrclk_rate;
+		__entry->duration_ns = duration_ns;
+		__entry->ret = ret;
+	),
+	TP_printk("bclk=%lu lrclk=%lu duration_ns=%llu ret=%d",
+		  __entry->bclk_rate, __entry->lrclk_rate,
+		  __entry->duration_ns, __entry->ret)
+);
+
+DECLARE_EVENT_CLASS(taudac_phase,
+	TP_PROTO(u64 duration_ns, int ret),
+	TP_ARGS(duration_ns, ret),
+	TP_STRUCT__entry(
+		__field(u64, duration_ns)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__entry->duration_ns = duration_ns;
+		__entry->ret = ret;
+	),
+	TP_printk("duration_ns=%llu ret=%d", __entry->duration_ns,
+		  __entry->ret)
+);
+
+DEFINE_EVENT(taudac_phase, taudac_i2s_clks_enable,
+	TP_PROTO(u64 duration_ns, int ret),
+	TP_ARGS(duration_ns, ret)
+);
+
+DEFINE_EVENT(taudac_phase, taudac_codecs_prepare,
+	TP_PROTO(u64 duration_ns, int ret),
+	TP_ARGS(duration_ns, ret)
+);
+
+DEFINE_EVENT(taudac_phase, taudac_codecs_startup,
+	TP_PROTO(u64 duration_ns, int ret),
+	TP_ARGS(duration_ns, ret)
+);
+
+DEFINE_EVENT(taudac_phase, taudac_codecs_shutdown,
+	TP_PROTO(u64 duration_ns, int ret),
+	TP_ARGS(duration_ns, ret)
+);
+
+TRACE_EVENT(taudac_hw_params,
+	TP_PROTO(unsigned int rate, int width, unsigned int mclk_rate,
+		 u64 duration_ns, int ret),
+	TP_ARGS(rate, width, mclk_rate, duration_ns, ret),
+	TP_STRUCT__entry(
+		__field(unsigned int, rate)
+		__field(int, width)
+		__field(unsigned int, mclk_rate)
+		__field(u64, duration_ns)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__entry->rate = rate;
+		__entry->width = width;
+		__entry->mclk_rate = mclk_rate;
+		__entry->duration_ns = duration_ns;
+		__entry->ret = ret;
+	),
+	TP_printk("rate=%u width=%d mclk=%u duration_ns=%llu ret=%d",
+		  __entry->rate, __entry->width, __entry->mclk_rate,
+		  __entry->duration_ns, __entry->ret)
+);
+#endif /* TAUDAC_TRACE_CARD */
+
+#ifdef TAUDAC_TRACE_SI5351
+/*
+ * Si5351 clock generator
+ */
+TRACE_EVENT(si5351_pll_reset,
+	TP_PROTO(struct device *dev, u8 mask, u64 duration_ns, int ret),
+	TP_ARGS(dev, mask, duration_ns, ret),
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__field(u8, mask)
+		__field(u64, duration_ns)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__assign_str(dev);
+		__entry->mask = mask;
+		__entry->duration_ns = duration_ns;
+		__entry->ret = ret;
+	),
+	TP_printk("%s mask=0x%02x duration_ns=%llu ret=%d", __get_str(dev),
+		  __entry->mask, __entry->duration_ns, __entry->ret)
+);
+
+TRACE_EVENT(si5351_burst,
+	TP_PROTO(struct device *dev, u8 reg, u8 count, u64 duration_ns,
+		 int ret),
+	TP_ARGS(dev, reg, count, duration_ns, ret),
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__field(u8, reg)
+		__field(u8, count)
+		__field(u64, duration_ns)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__assign_str(dev);
+		__entry->reg = reg;
+		__entry->count = count;
+		__entry->duration_ns = duration_ns;
+		__entry->ret = ret;
+	),
+	TP_printk("%s reg=%u count=%u duration_ns=%llu ret=%d",
+		  __get_str(dev), __entry->reg, __entry->count,
+		  __entry->duration_ns, __entry->ret)
+);
+#endif /* TAUDAC_TRACE_SI5351 */
+
+#ifdef TAUDAC_TRACE_WM8741
+/*
+ * WM8741 codec
+ */
+TRACE_EVENT(wm8741_hw_params,
+	TP_PROTO(struct device *dev, unsigned int rate, int width,
+		 unsigned int sysclk),
+	TP_ARGS(dev, rate, width, sysclk),
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__field(unsigned int, rate)
+		__field(int, width)
+		__field(unsigned int, sysclk)
+	),
+	TP_fast_assign(
+		__assign_str(dev);
+		__entry->rate = rate;
+		__entry->width = width;
+		__entry->sysclk = sysclk;
+	),
+	TP_printk("%s rate=%u width=%d sysclk=%u", __get_str(dev),
+		  __entry->rate, __entry->width, __entry->sysclk)
+);
+
+TRACE_EVENT(wm8741_runtime_resume,
+	TP_PROTO(struct device *dev, u64 duration_ns, int ret),
+	TP_ARGS(dev, duration_ns, ret),
+	TP_STRUCT__entry(
+		__string(dev, dev_name(dev))
+		__field(u64, duration_ns)
+		__field(int, ret)
+	),
+	TP_fast_assign(
+		__assign_str(dev);
+		__entry->duration_ns = duration_ns;
+		__entry->ret = ret;
+	),
+	TP_printk("%s duration_ns=%llu ret=%d", __get_str(dev),
+		  __entry->duration_ns, __entry->ret)
+);
+#endif /* TAUDAC_TRACE_WM8741 */
+
+#endif /* _TAUDAC_TRACE_H */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE taudac_trace
+#include <trace/define_trace.h>
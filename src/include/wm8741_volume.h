@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0-only */
+/*
+ * WM8741 attenuation mapping, shared by the codec driver and the host
+ * benchmark
+ *
+ * The 10-bit attenuation is split over an LSB and an MSB register. The
+ * MSB value carries the update bit, which latches both halves, so it has
+ * to be written last.
+ */
+#ifndef _WM8741_VOLUME_H
+#define _WM8741_VOLUME_H
+
+#include <linux/types.h>
+
+static inline void wm8741_volume_to_regs(unsigned int val, unsigned int max,
+					 bool invert, unsigned int shift,
+					 unsigned int *lsb, unsigned int *msb)
+{
+	unsigned int upd = 1 << shift;
+
+	if (invert)
+		val = max - val;
+
+	*lsb = val & (upd - 1);
+	*msb = (val >> shift) | upd;
+}
+
+static inline unsigned int wm8741_volume_from_regs(unsigned int lsb,
+						   unsigned int msb,
+						   unsigned int max,
+						   bool invert,
+						   unsigned int shift)
+{
+	unsigned int val = ((msb << shift) | lsb) & max;
+
+	if (invert)
+		val = max - val;
+
+	return val;
+}
+
+#endif /* _WM8741_VOLUME_H */